@@ -12,11 +12,18 @@ static const char col_gray2[]       = "#444444";
 static const char col_gray3[]       = "#bbbbbb";
 static const char col_gray4[]       = "#eeeeee";
 static const char col_cyan[]        = "#005577";
-static const char *colors[][3]      = {
+static const char *colors[SchemeLast][3] = {
 	/*               fg         bg         border   */
 	[SchemeNorm] = { col_gray3, col_gray1, col_gray2 },
 	[SchemeSel]  = { col_gray4, col_cyan,  col_cyan  },
 };
+static const char *nightcolors[SchemeLast][3] = {
+	/*               fg         bg         border   */
+	[SchemeNorm] = { "#a89984", "#1d2021", "#32302f" },
+	[SchemeSel]  = { "#d5c4a1", "#4f3a1e", "#4f3a1e" },
+};
+/* tables for setpalette, each with all SchemeLast schemes; the first is used at startup */
+static const char *(*palettes[])[3] = { colors, nightcolors };
 
 /* tagging */
 static const char *tags[] = { "1", "2", "3", "4", "5", "6", "7", "8", "9" };
@@ -36,6 +43,36 @@ static const float mfact     = 0.55; /* factor of master area size [0.05..0.95]
 static const int nmaster     = 1;    /* number of clients in master area */
 static const int resizehints = 1;    /* 1 means respect size hints in tiled resizals */
 static const int lockfullscreen = 1; /* 1 will force focus on the fullscreen window */
+static const int fullscreenquiet = 1; /* 1 skips bar redraws and root pointer motion while a fullscreen window has the focused monitor */
+/* windows on hidden tags: HideMove moves them off-screen, HideIconic also
+ * marks them iconic and _NET_WM_STATE_HIDDEN, HideUnmap unmaps them too */
+static const int hidemode = HideMove;
+
+/* command socket, relative to $XDG_RUNTIME_DIR unless absolute, "" disables it;
+ * without $XDG_RUNTIME_DIR it is /tmp/<ipcsocket>-<uid>-<display> */
+static const char ipcsocket[] = "dwm.sock";
+/* shared memory segment with a snapshot of the state, see shm.h; the user id
+ * and display are appended, "" disables it */
+static const char shmname[] = "dwm";
+
+static const unsigned int barinterval = 16; /* minimum ms between bar redraws, one 60 Hz frame */
+static const unsigned int proprate    = 10; /* title and hint updates handled per client and second, 0 for no limit */
+static const unsigned int propburst   = 5;  /* updates handled at once before proprate applies */
+static const int focusfollowsmouse    = 1;  /* 0 focuses windows and monitors on click only */
+static const unsigned int focusdwell  = 40; /* ms the pointer rests on a window before it gets focus, 0 for at once */
+
+/* status text made by dwm on a thread of its own, instead of read from the
+ * root window name; 0 keeps xsetroot(1) and the like working */
+static const int builtinstatus = 0;
+static const char statussep[]  = " | ";
+static const StatusModule statusmods[] = {
+	/* function        argument            interval (ms) */
+	{ status_net,      "eth0",             2000 },
+	{ status_load,     NULL,               5000 },
+	{ status_mem,      NULL,               5000 },
+	{ status_battery,  "BAT0",             30000 },
+	{ status_clock,    "%a %d %b %H:%M",   1000 },
+};
 
 static const Layout layouts[] = {
 	/* symbol     arrange function */
@@ -60,11 +97,17 @@ static char dmenumon[2] = "0"; /* component of dmenucmd, manipulated in spawn()
 static const char *dmenucmd[] = { "dmenu_run", "-m", dmenumon, "-fn", dmenufont, "-nb", col_gray1, "-nf", col_gray3, "-sb", col_cyan, "-sf", col_gray4, NULL };
 static const char *termcmd[]  = { "st", NULL };
 
+/* commands kept started in advance, spawn() maps a waiting instance at once;
+ * instances per command, 0 disables the pool */
+static const unsigned int poolsize = 0;
+static const char **poolcmds[] = { termcmd };
+
 static const Key keys[] = {
 	/* modifier                     key        function        argument */
 	{ MODKEY,                       XK_p,      spawn,          {.v = dmenucmd } },
 	{ MODKEY|ShiftMask,             XK_Return, spawn,          {.v = termcmd } },
 	{ MODKEY,                       XK_b,      togglebar,      {0} },
+	{ MODKEY|ShiftMask,             XK_n,      setpalette,     {.i = -1} },
 	{ MODKEY,                       XK_j,      focusstack,     {.i = +1 } },
 	{ MODKEY,                       XK_k,      focusstack,     {.i = -1 } },
 	{ MODKEY,                       XK_i,      incnmaster,     {.i = +1 } },
@@ -95,6 +138,7 @@ static const Key keys[] = {
 	TAGKEYS(                        XK_8,                      7)
 	TAGKEYS(                        XK_9,                      8)
 	{ MODKEY|ShiftMask,             XK_q,      quit,           {0} },
+	{ MODKEY|ControlMask|ShiftMask, XK_q,      restart,        {0} },
 };
 
 /* button definitions */
@@ -10,15 +10,25 @@ const X11LIB = .{ .path = "/usr/lib/xorg" };
 const FREETYPELIBS = [_][]const u8{ "fontconfig", "Xft" };
 const FREETYPEINC = .{ .path = "/usr/include/freetype2" };
 
+// XCB, set to true to batch property requests through libX11-xcb and libxcb
+const XCB = false;
+const XCBLIBS = if (XCB) [_][]const u8{ "X11-xcb", "xcb" } else [_][]const u8{};
+const XCBFLAGS = if (XCB) [_][]const u8{"-DXCB"} else [_][]const u8{};
+
+// allocation accounting, set to true to report allocations by kind on SIGUSR1
+// and leaks at exit
+const ALLOCSTATS = false;
+const ALLOCFLAGS = if (ALLOCSTATS) [_][]const u8{"-DALLOCSTATS"} else [_][]const u8{};
+
 const INCS = [_]std.Build.LazyPath{ X11INC, FREETYPEINC };
-const LIBS = [_][]const u8{"X11"} ++ FREETYPELIBS;
+const LIBS = [_][]const u8{"X11"} ++ XCBLIBS ++ FREETYPELIBS ++ [_][]const u8{ "pthread", "rt" };
 
 const CPPFLAGS = [_][]const u8{
     "-D_DEFAULT_SOURCE",
     "-D_BSD_SOURCE",
     "-D_XOPEN_SOURCE=700L",
     "-DVERSION=\"" ++ VERSION ++ "\"",
-};
+} ++ XCBFLAGS ++ ALLOCFLAGS;
 const CFLAGS = [_][]const u8{
     "-std=c99",
     "-pedantic",
@@ -27,7 +37,7 @@ const CFLAGS = [_][]const u8{
 } ++ CPPFLAGS;
 const LDFLAG = LIBS;
 
-const SRC = [_][]const u8{ "src/drw.c", "src/dwm.c", "src/util.c" };
+const SRC = [_][]const u8{ "src/drw.c", "src/dwm.c", "src/grid.c", "src/ipc.c", "src/layout.c", "src/loop.c", "src/shm.c", "src/status.c", "src/util.c" };
 
 pub fn build(b: *std.Build) !void {
     const target = b.standardTargetOptions(.{});
@@ -92,6 +102,49 @@ pub fn build(b: *std.Build) !void {
         b.getInstallStep().dependOn(&file.step);
     }
 
+    // layout.c against the baseline arithmetic, and its timings
+    const layout_test = b.addExecutable(.{
+        .name = "layout",
+        .target = target,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    layout_test.addCSourceFiles(&.{ "test/layout.c", "src/layout.c", "src/util.c" }, &CFLAGS);
+    const check_cmd = b.addRunArtifact(layout_test);
+    const check_step = b.step("check", "compare layout.c with the baseline arithmetic");
+    check_step.dependOn(&check_cmd.step);
+    // the same with the allocation accounting, which has to end with none live
+    const layout_alloc = b.addExecutable(.{
+        .name = "layout-alloc",
+        .target = target,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    layout_alloc.addCSourceFiles(&.{ "test/layout.c", "src/layout.c", "src/util.c" }, &(CFLAGS ++ [_][]const u8{"-DALLOCSTATS"}));
+    check_step.dependOn(&b.addRunArtifact(layout_alloc).step);
+    // grid.c against a linear scan
+    const grid_test = b.addExecutable(.{
+        .name = "grid",
+        .target = target,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    grid_test.addCSourceFiles(&.{ "test/grid.c", "src/grid.c", "src/util.c" }, &CFLAGS);
+    check_step.dependOn(&b.addRunArtifact(grid_test).step);
+    const bench_cmd = b.addRunArtifact(layout_test);
+    bench_cmd.addArg("-b");
+    const bench_step = b.step("bench", "time the layouts for 10 to 10000 clients, and fork() against posix_spawn()");
+    bench_step.dependOn(&bench_cmd.step);
+    // the exec latency of fork() against posix_spawn()
+    const spawn_bench = b.addExecutable(.{
+        .name = "spawn",
+        .target = target,
+        .optimize = .ReleaseFast,
+        .link_libc = true,
+    });
+    spawn_bench.addCSourceFiles(&.{ "test/spawn.c", "src/util.c" }, &CFLAGS);
+    bench_step.dependOn(&b.addRunArtifact(spawn_bench).step);
+
     const clean_step = b.step("clean", "clean build dirctories.");
     for ([_][]const u8{
         "zig-out",
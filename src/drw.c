@@ -1,7 +1,12 @@
 /* See LICENSE file for copyright and license details. */
+#include <pthread.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
 #include <X11/Xlib.h>
 #include <X11/Xft/Xft.h>
 
@@ -11,11 +16,69 @@
 #define UTF_INVALID 0xFFFD
 #define UTF_SIZ     4
 
+#define FONTCACHE_MAGIC   "dwm-fontcache"
+#define FONTCACHE_VERSION 1
+
 static const unsigned char utfbyte[UTF_SIZ + 1] = {0x80,    0, 0xC0, 0xE0, 0xF0};
 static const unsigned char utfmask[UTF_SIZ + 1] = {0xC0, 0x80, 0xE0, 0xF0, 0xF8};
 static const long utfmin[UTF_SIZ + 1] = {       0,    0,  0x80,  0x800,  0x10000};
 static const long utfmax[UTF_SIZ + 1] = {0x10FFFF, 0x7F, 0x7FF, 0xFFFF, 0x10FFFF};
 
+/* keep track of a couple codepoints for which we have no match. */
+enum { nomatches_len = 64 };
+static struct { long codepoint[nomatches_len]; unsigned int idx; } nomatches;
+
+/* Fallback matching done off the main thread. Requests and results are
+ * handed over under fblock; everything touching Xlib or Xft, including
+ * opening the matched font, stays on the main thread. */
+typedef struct FontReq {
+	long codepoint;
+	FcPattern *pattern;
+	FcPattern *match;
+	struct FontReq *next;
+} FontReq;
+
+enum { fbpending_len = 64 };
+static pthread_t fbthread;
+static pthread_mutex_t fblock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fbcond = PTHREAD_COND_INITIALIZER;
+static FontReq *fbtodo, *fbdone; /* protected by fblock */
+static int fbstop;               /* protected by fblock */
+static int fbfd = -1;            /* eventfd, signalled for each result */
+static long fbpending[fbpending_len]; /* requested, not yet collected */
+static unsigned int nfbpending;
+
+/* Resolved fonts kept across restarts: fonts[] entries by name, and the
+ * fallbacks picked for the primary font along with the codepoints they
+ * were matched for. Patterns are stored unparsed and without charset, so
+ * reopening one skips fontconfig matching altogether. */
+typedef struct FontCacheEnt {
+	char *key;       /* fonts[] entry, or primary font name for fallbacks */
+	char *pattern;
+	long *codepoints;
+	unsigned int ncodepoints;
+	int fallback, tried;
+	struct FontCacheEnt *next;
+} FontCacheEnt;
+
+static FontCacheEnt *fontcache;
+static int fontcachedirty;
+static long long fontcachestamp;
+static const char *primaryname; /* fonts[] entry of drw->fonts */
+
+/* Server-side copies of text that rarely changes, so redrawing it is a
+ * single XCopyArea instead of rasterizing it through Xft again. */
+enum { textcache_len = 64 };
+static struct {
+	char *text;
+	Clr *scheme;
+	int invert;
+	unsigned int w, h, lpad;
+	Pixmap pixmap;
+	unsigned long used;
+} textcache[textcache_len];
+static unsigned long textcacheclock;
+
 static long
 utf8decodebyte(const char c, size_t *i)
 {
@@ -60,6 +123,38 @@ utf8decode(const char *c, long *u, size_t clen)
 	return len;
 }
 
+/* returns the number of ASCII bytes at the start of s, up to end */
+static size_t
+asciispan(const char *s, const char *end)
+{
+	const char *p = s;
+	uint64_t v;
+
+	/* a word at a time while whole words remain */
+	for (; end - p >= (ptrdiff_t)sizeof(v); p += sizeof(v)) {
+		memcpy(&v, p, sizeof(v));
+		if (v & 0x8080808080808080ULL)
+			break;
+	}
+	while (p < end && !(*p & 0x80))
+		p++;
+	return p - s;
+}
+
+static void
+fontcache_free(void)
+{
+	FontCacheEnt *e;
+
+	while ((e = fontcache)) {
+		fontcache = e->next;
+		free(e->key);
+		free(e->pattern);
+		free(e->codepoints);
+		free(e);
+	}
+}
+
 Drw *
 drw_create(Display *dpy, int screen, Window root, unsigned int w, unsigned int h)
 {
@@ -93,12 +188,149 @@ drw_resize(Drw *drw, unsigned int w, unsigned int h)
 void
 drw_free(Drw *drw)
 {
+	drw_fallback_stop(drw);
+	drw_textcache_clear(drw);
 	XFreePixmap(drw->dpy, drw->drawable);
 	XFreeGC(drw->dpy, drw->gc);
 	drw_fontset_free(drw->fonts);
+	fontcache_free();
 	free(drw);
 }
 
+/* newest mtime of the fontconfig configuration and font directories */
+static long long
+fontcache_stamp(void)
+{
+	FcStrList *l[2] = { FcConfigGetConfigFiles(NULL), FcConfigGetFontDirs(NULL) };
+	FcChar8 *f;
+	struct stat st;
+	long long t = 0;
+	int i;
+
+	for (i = 0; i < 2; i++) {
+		if (!l[i])
+			continue;
+		while ((f = FcStrListNext(l[i])))
+			if (!stat((char *)f, &st) && st.st_mtime > t)
+				t = st.st_mtime;
+		FcStrListDone(l[i]);
+	}
+	return t;
+}
+
+static char *
+fontcache_unparse(FcPattern *p)
+{
+	FcPattern *dup = FcPatternDuplicate(p);
+	FcChar8 *s;
+
+	FcPatternDel(dup, FC_CHARSET);
+	FcPatternDel(dup, FC_LANG);
+	s = FcNameUnparse(dup);
+	FcPatternDestroy(dup);
+	return (char *)s;
+}
+
+static FontCacheEnt *
+fontcache_new(int fallback, const char *key, char *pattern)
+{
+	FontCacheEnt *e = ecalloc(1, sizeof(FontCacheEnt));
+
+	if (!(e->key = strdup(key)))
+		die("strdup:");
+	e->pattern = pattern;
+	e->fallback = fallback;
+	e->next = fontcache;
+	fontcache = e;
+	return e;
+}
+
+static void
+fontcache_addcodepoint(FontCacheEnt *e, long codepoint)
+{
+	unsigned int i;
+
+	for (i = 0; i < e->ncodepoints; i++)
+		if (e->codepoints[i] == codepoint)
+			return;
+	if (!(e->codepoints = realloc(e->codepoints, (e->ncodepoints + 1) * sizeof(long))))
+		die("realloc:");
+	e->codepoints[e->ncodepoints++] = codepoint;
+	fontcachedirty = 1;
+}
+
+/* records how key resolved; codepoint is only used for fallbacks */
+static void
+fontcache_add(int fallback, const char *key, FcPattern *resolved, long codepoint)
+{
+	FontCacheEnt *e;
+	char *pattern;
+
+	if (!key || !(pattern = fontcache_unparse(resolved)))
+		return;
+	for (e = fontcache; e; e = e->next)
+		if (e->fallback == fallback && !strcmp(e->key, key) &&
+		    (!fallback || !strcmp(e->pattern, pattern)))
+			break;
+	if (!e) {
+		e = fontcache_new(fallback, key, pattern);
+		fontcachedirty = 1;
+	} else if (strcmp(e->pattern, pattern)) {
+		free(e->pattern);
+		e->pattern = pattern;
+		fontcachedirty = 1;
+	} else {
+		free(pattern);
+	}
+	if (fallback)
+		fontcache_addcodepoint(e, codepoint);
+}
+
+static XftFont *
+fontcache_open(Drw *drw, FontCacheEnt *e)
+{
+	FcPattern *p;
+	XftFont *xfont;
+
+	e->tried = 1;
+	if (!(p = FcNameParse((FcChar8 *)e->pattern)))
+		return NULL;
+	if (!(xfont = XftFontOpenPattern(drw->dpy, p)))
+		FcPatternDestroy(p);
+	return xfont;
+}
+
+static XftFont *
+fontcache_primary(Drw *drw, const char *fontname)
+{
+	FontCacheEnt *e;
+
+	for (e = fontcache; e; e = e->next)
+		if (!e->fallback && !strcmp(e->key, fontname))
+			return e->tried ? NULL : fontcache_open(drw, e);
+	return NULL;
+}
+
+/* measures the ASCII glyphs once, so that drw_text() does not have to ask
+ * Xft about each character of the mostly ASCII titles and status text;
+ * done on first use, as only the primary font needs it */
+static void
+xfont_advances(Fnt *font)
+{
+	XGlyphInfo ext;
+	FcChar8 c;
+
+	font->advance[0] = -1;
+	for (c = 1; c < 128; c++) {
+		if (XftCharExists(font->dpy, font->xfont, c)) {
+			XftTextExtents8(font->dpy, font->xfont, &c, 1, &ext);
+			font->advance[c] = ext.xOff;
+		} else {
+			font->advance[c] = -1;
+		}
+	}
+}
+
 /* This function is an implementation detail. Library users should use
  * drw_fontset_create instead.
  */
@@ -115,9 +347,12 @@ xfont_create(Drw *drw, const char *fontname, FcPattern *fontpattern)
 		 * FcNameParse; using the latter results in the desired fallback
 		 * behaviour whereas the former just results in missing-character
 		 * rectangles being drawn, at least with some fonts. */
-		if (!(xfont = XftFontOpenName(drw->dpy, drw->screen, fontname))) {
-			fprintf(stderr, "error, cannot load font from name: '%s'\n", fontname);
-			return NULL;
+		if (!(xfont = fontcache_primary(drw, fontname))) {
+			if (!(xfont = XftFontOpenName(drw->dpy, drw->screen, fontname))) {
+				fprintf(stderr, "error, cannot load font from name: '%s'\n", fontname);
+				return NULL;
+			}
+			fontcache_add(0, fontname, xfont->pattern, 0);
 		}
 		if (!(pattern = FcNameParse((FcChar8 *) fontname))) {
 			fprintf(stderr, "error, cannot parse font name to pattern: '%s'\n", fontname);
@@ -153,6 +388,40 @@ xfont_free(Fnt *font)
 	free(font);
 }
 
+/* opens the fallback the cache remembers for codepoint, if any */
+static Fnt *
+fontcache_fallback(Drw *drw, long codepoint)
+{
+	FontCacheEnt *e;
+	XftFont *xfont;
+	Fnt *font, *curfont;
+	unsigned int i;
+
+	if (!primaryname)
+		return NULL;
+	for (e = fontcache; e; e = e->next) {
+		if (!e->fallback || e->tried || strcmp(e->key, primaryname))
+			continue;
+		for (i = 0; i < e->ncodepoints && e->codepoints[i] != codepoint; i++)
+			;
+		if (i == e->ncodepoints || !(xfont = fontcache_open(drw, e)))
+			continue;
+		if (!XftCharExists(drw->dpy, xfont, codepoint)) {
+			XftFontClose(drw->dpy, xfont);
+			continue;
+		}
+		font = ecalloc(1, sizeof(Fnt));
+		font->xfont = xfont;
+		font->h = xfont->ascent + xfont->descent;
+		font->dpy = drw->dpy;
+		for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
+			; /* NOP */
+		curfont->next = font;
+		return font;
+	}
+	return NULL;
+}
+
 Fnt*
 drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 {
@@ -166,6 +435,7 @@ drw_fontset_create(Drw* drw, const char *fonts[], size_t fontcount)
 		if ((cur = xfont_create(drw, fonts[fontcount - i], NULL))) {
 			cur->next = ret;
 			ret = cur;
+			primaryname = fonts[fontcount - i];
 		}
 	}
 	return (drw->fonts = ret);
@@ -180,12 +450,291 @@ drw_fontset_free(Fnt *font)
 	}
 }
 
+/* Loads the font cache at path; call before drw_fontset_create(). The
+ * cache is dropped if fontconfig's configuration or font directories
+ * changed since it was written. */
+void
+drw_fontcache_load(Drw *drw, const char *path)
+{
+	FILE *f;
+	FontCacheEnt *e;
+	char *line = NULL, *kind, *key, *pattern, *cps, *end;
+	size_t size = 0;
+	long long stamp;
+	long cp;
+	int version;
+
+	fontcachestamp = fontcache_stamp();
+	if (!drw || !path || !*path || !(f = fopen(path, "r")))
+		return;
+	if (getline(&line, &size, f) < 0 ||
+	    sscanf(line, FONTCACHE_MAGIC " %d %lld", &version, &stamp) != 2 ||
+	    version != FONTCACHE_VERSION || stamp != fontcachestamp) {
+		fontcachedirty = 1;
+		goto out;
+	}
+	while (getline(&line, &size, f) > 0) {
+		line[strcspn(line, "\n")] = '\0';
+		if (!(kind = strtok(line, "\t")) || !(key = strtok(NULL, "\t")) ||
+		    !(pattern = strtok(NULL, "\t")))
+			continue;
+		cps = strtok(NULL, "\t");
+		if (!strcmp(kind, "font")) {
+			fontcache_new(0, key, strdup(pattern));
+		} else if (!strcmp(kind, "fallback") && cps) {
+			e = fontcache_new(1, key, strdup(pattern));
+			for (; (cp = strtol(cps, &end, 16)), end != cps; cps = end)
+				fontcache_addcodepoint(e, cp);
+		}
+	}
+	fontcachedirty = 0;
+out:
+	free(line);
+	fclose(f);
+}
+
+/* Writes the font cache to path if anything was resolved anew. */
+void
+drw_fontcache_save(Drw *drw, const char *path)
+{
+	FILE *f;
+	FontCacheEnt *e;
+	char *tmp;
+	unsigned int i;
+	int err;
+
+	if (!drw || !path || !*path || !fontcachedirty)
+		return;
+	if (!fontcachestamp)
+		fontcachestamp = fontcache_stamp();
+	tmp = ecalloc(1, strlen(path) + sizeof(".tmp"));
+	sprintf(tmp, "%s.tmp", path);
+	if (!(f = fopen(tmp, "w"))) {
+		free(tmp);
+		return;
+	}
+	fprintf(f, "%s %d %lld\n", FONTCACHE_MAGIC, FONTCACHE_VERSION, fontcachestamp);
+	for (e = fontcache; e; e = e->next) {
+		if (!e->pattern)
+			continue;
+		fprintf(f, "%s\t%s\t%s", e->fallback ? "fallback" : "font", e->key, e->pattern);
+		for (i = 0; i < e->ncodepoints; i++)
+			fprintf(f, "%c%lx", i ? ' ' : '\t', e->codepoints[i]);
+		fputc('\n', f);
+	}
+	err = ferror(f);
+	if (fclose(f) || err || rename(tmp, path))
+		unlink(tmp);
+	else
+		fontcachedirty = 0;
+	free(tmp);
+}
+
+static void *
+fallback_worker(void *arg)
+{
+	FontReq *r;
+	FcResult result;
+	uint64_t one = 1;
+
+	pthread_mutex_lock(&fblock);
+	while (1) {
+		while (!fbtodo && !fbstop)
+			pthread_cond_wait(&fbcond, &fblock);
+		if (fbstop)
+			break;
+		r = fbtodo;
+		fbtodo = r->next;
+		pthread_mutex_unlock(&fblock);
+
+		FcConfigSubstitute(NULL, r->pattern, FcMatchPattern);
+		FcDefaultSubstitute(r->pattern);
+		r->match = FcFontMatch(NULL, r->pattern, &result);
+
+		pthread_mutex_lock(&fblock);
+		r->next = fbdone;
+		fbdone = r;
+		if (write(fbfd, &one, sizeof(one)) < 0)
+			; /* counter already pending */
+	}
+	pthread_mutex_unlock(&fblock);
+	return NULL;
+}
+
+static void
+freereqs(FontReq *r)
+{
+	FontReq *next;
+
+	for (; r; r = next) {
+		next = r->next;
+		FcPatternDestroy(r->pattern);
+		if (r->match)
+			FcPatternDestroy(r->match);
+		free(r);
+	}
+}
+
+/* Starts resolving fallback fonts asynchronously. Returns a descriptor that
+ * becomes readable when drw_fallback_collect() has work to do, or -1 if
+ * matching stays synchronous. */
+int
+drw_fallback_start(Drw *drw)
+{
+	if (!drw || fbfd >= 0)
+		return fbfd;
+	if ((fbfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+		return -1;
+	fbstop = 0;
+	if (pthread_create(&fbthread, NULL, fallback_worker, NULL)) {
+		close(fbfd);
+		return (fbfd = -1);
+	}
+	return fbfd;
+}
+
+void
+drw_fallback_stop(Drw *drw)
+{
+	if (!drw || fbfd < 0)
+		return;
+	pthread_mutex_lock(&fblock);
+	fbstop = 1;
+	pthread_cond_signal(&fbcond);
+	pthread_mutex_unlock(&fblock);
+	pthread_join(fbthread, NULL);
+	freereqs(fbtodo);
+	freereqs(fbdone);
+	fbtodo = fbdone = NULL;
+	nfbpending = 0;
+	close(fbfd);
+	fbfd = -1;
+}
+
+static void
+fallback_request(Drw *drw, long codepoint)
+{
+	FcCharSet *fccharset;
+	FontReq *r;
+	unsigned int i;
+
+	for (i = 0; i < nfbpending; i++)
+		if (fbpending[i] == codepoint)
+			return;
+	if (nfbpending == fbpending_len)
+		return; /* asked again on a later redraw */
+	fbpending[nfbpending++] = codepoint;
+
+	fccharset = FcCharSetCreate();
+	FcCharSetAddChar(fccharset, codepoint);
+	r = ecalloc(1, sizeof(FontReq));
+	r->codepoint = codepoint;
+	r->pattern = FcPatternDuplicate(drw->fonts->pattern);
+	FcPatternAddCharSet(r->pattern, FC_CHARSET, fccharset);
+	FcPatternAddBool(r->pattern, FC_SCALABLE, FcTrue);
+	FcCharSetDestroy(fccharset);
+	/* the Xft defaults come from the X resources and so cannot be
+	 * filled in by the worker */
+	XftDefaultSubstitute(drw->dpy, drw->screen, r->pattern);
+
+	pthread_mutex_lock(&fblock);
+	r->next = fbtodo;
+	fbtodo = r;
+	pthread_cond_signal(&fbcond);
+	pthread_mutex_unlock(&fblock);
+}
+
+/* Opens the fonts matched since the last call and appends them to the
+ * fallback chain. Returns the number of fonts added; text drawn with
+ * placeholders since then should be redrawn if it is nonzero. */
+int
+drw_fallback_collect(Drw *drw)
+{
+	FontReq *r, *done;
+	Fnt *font, *curfont;
+	uint64_t n;
+	unsigned int i;
+	int added = 0;
+
+	if (!drw || fbfd < 0)
+		return 0;
+	if (read(fbfd, &n, sizeof(n)) < 0)
+		; /* nothing signalled, the list may still hold results */
+	pthread_mutex_lock(&fblock);
+	done = fbdone;
+	fbdone = NULL;
+	pthread_mutex_unlock(&fblock);
+
+	for (r = done; r; r = r->next) {
+		for (i = 0; i < nfbpending && fbpending[i] != r->codepoint; i++)
+			;
+		if (i < nfbpending)
+			fbpending[i] = fbpending[--nfbpending];
+		/* an earlier result may already cover this codepoint */
+		for (curfont = drw->fonts; curfont; curfont = curfont->next)
+			if (XftCharExists(drw->dpy, curfont->xfont, r->codepoint))
+				break;
+		if (curfont)
+			continue;
+		font = r->match ? xfont_create(drw, NULL, r->match) : NULL;
+		if (font)
+			r->match = NULL; /* owned by the font now */
+		if (font && XftCharExists(drw->dpy, font->xfont, r->codepoint)) {
+			for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
+				; /* NOP */
+			curfont->next = font;
+			fontcache_add(1, primaryname, font->xfont->pattern, r->codepoint);
+			added++;
+		} else {
+			xfont_free(font);
+			nomatches.codepoint[++nomatches.idx % nomatches_len] = r->codepoint;
+		}
+	}
+	freereqs(done);
+	return added;
+}
+
+/* scales a 16 bit channel into the bits of a TrueColor mask */
+static unsigned long
+clr_channel(unsigned int v, unsigned long mask)
+{
+	int shift = 0, bits = 0;
+
+	if (!mask)
+		return 0;
+	for (; !(mask & 1); mask >>= 1)
+		shift++;
+	for (; mask & 1; mask >>= 1)
+		bits++;
+	return bits > 16 ? (unsigned long)v << (bits - 16) << shift
+	                 : (unsigned long)(v >> (16 - bits)) << shift;
+}
+
 void
 drw_clr_create(Drw *drw, Clr *dest, const char *clrname)
 {
+	Visual *visual;
+	unsigned int r, g, b;
+
 	if (!drw || !dest || !clrname)
 		return;
 
+	/* On TrueColor visuals "#rrggbb" maps to a pixel value without asking
+	 * the server, so there is no colormap round-trip per color. */
+	visual = DefaultVisual(drw->dpy, drw->screen);
+	if (visual->class == TrueColor && clrname[0] == '#' &&
+	    strlen(clrname) == 7 && strspn(clrname + 1, "0123456789abcdefABCDEF") == 6 &&
+	    sscanf(clrname + 1, "%2x%2x%2x", &r, &g, &b) == 3) {
+		dest->color.red = r * 0x101;
+		dest->color.green = g * 0x101;
+		dest->color.blue = b * 0x101;
+		dest->color.alpha = 0xffff;
+		dest->pixel = clr_channel(dest->color.red, visual->red_mask) |
+		              clr_channel(dest->color.green, visual->green_mask) |
+		              clr_channel(dest->color.blue, visual->blue_mask);
+		return;
+	}
+
 	if (!XftColorAllocName(drw->dpy, DefaultVisual(drw->dpy, drw->screen),
 	                       DefaultColormap(drw->dpy, drw->screen),
 	                       clrname, dest))
@@ -212,8 +761,10 @@ drw_scm_create(Drw *drw, const char *clrnames[], size_t clrcount)
 void
 drw_setfontset(Drw *drw, Fnt *set)
 {
-	if (drw)
+	if (drw) {
 		drw->fonts = set;
+		drw_textcache_clear(drw);
+	}
 }
 
 void
@@ -238,21 +789,19 @@ drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int
 int
 drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
 {
-	int i, ty, ellipsis_x = 0;
+	int i, ty, adv, ellipsis_x = 0;
 	unsigned int tmpw, ew, ellipsis_w = 0, ellipsis_len;
+	size_t n;
 	XftDraw *d = NULL;
 	Fnt *usedfont, *curfont, *nextfont;
 	int utf8strlen, utf8charlen, render = x || y || w || h;
 	long utf8codepoint = 0;
-	const char *utf8str;
+	const char *utf8str, *end;
 	FcCharSet *fccharset;
 	FcPattern *fcpattern;
 	FcPattern *match;
 	XftResult result;
 	int charexists = 0, overflow = 0;
-	/* keep track of a couple codepoints for which we have no match. */
-	enum { nomatches_len = 64 };
-	static struct { long codepoint[nomatches_len]; unsigned int idx; } nomatches;
 	static unsigned int ellipsis_width = 0;
 
 	if (!drw || (render && (!drw->scheme || !w)) || !text || !drw->fonts)
@@ -271,6 +820,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 	}
 
 	usedfont = drw->fonts;
+	end = text + strlen(text);
 	if (!ellipsis_width && render)
 		ellipsis_width = drw_fontset_getwidth(drw, "...");
 	while (1) {
@@ -278,6 +828,33 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 		utf8str = text;
 		nextfont = NULL;
 		while (*text) {
+			/* ASCII the primary font has is measured from its table */
+			if (usedfont == drw->fonts) {
+				if (!usedfont->advance[0])
+					xfont_advances(usedfont);
+				for (n = asciispan(text, end); n; n--, text++) {
+					if ((adv = usedfont->advance[(unsigned char)*text]) < 0)
+						break;
+					if (ew + ellipsis_width <= w) {
+						ellipsis_x = x + ew;
+						ellipsis_w = w - ew;
+						ellipsis_len = utf8strlen;
+					}
+					if (ew + adv > w) {
+						overflow = 1;
+						if (!render)
+							x += adv;
+						else
+							utf8strlen = ellipsis_len;
+						break;
+					}
+					utf8strlen++;
+					ew += adv;
+					charexists = 0;
+				}
+				if (overflow || !*text)
+					break;
+			}
 			utf8charlen = utf8decode(text, &utf8codepoint, UTF_SIZ);
 			for (curfont = drw->fonts; curfont; curfont = curfont->next) {
 				charexists = charexists || XftCharExists(drw->dpy, curfont->xfont, utf8codepoint);
@@ -344,14 +921,28 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 					goto no_match;
 			}
 
-			fccharset = FcCharSetCreate();
-			FcCharSetAddChar(fccharset, utf8codepoint);
-
 			if (!drw->fonts->pattern) {
 				/* Refer to the comment in xfont_create for more information. */
 				die("the first font in the cache must be loaded from a font string.");
 			}
 
+			if ((curfont = fontcache_fallback(drw, utf8codepoint))) {
+				usedfont = curfont;
+				continue;
+			}
+
+			if (fbfd >= 0) {
+				/* Until the worker found a font, the primary font draws
+				 * its missing-character glyph as a placeholder. */
+				fallback_request(drw, utf8codepoint);
+				if (render)
+					drw->placeholders++;
+				goto no_match;
+			}
+
+			fccharset = FcCharSetCreate();
+			FcCharSetAddChar(fccharset, utf8codepoint);
+
 			fcpattern = FcPatternDuplicate(drw->fonts->pattern);
 			FcPatternAddCharSet(fcpattern, FC_CHARSET, fccharset);
 			FcPatternAddBool(fcpattern, FC_SCALABLE, FcTrue);
@@ -369,6 +960,7 @@ drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lp
 					for (curfont = drw->fonts; curfont->next; curfont = curfont->next)
 						; /* NOP */
 					curfont->next = usedfont;
+					fontcache_add(1, primaryname, usedfont->xfont->pattern, utf8codepoint);
 				} else {
 					xfont_free(usedfont);
 					nomatches.codepoint[++nomatches.idx % nomatches_len] = utf8codepoint;
@@ -384,6 +976,76 @@ no_match:
 	return x + (render ? w : 0);
 }
 
+/* Like drw_text(), but keeps the rendered cell in a Pixmap keyed by text,
+ * scheme and size. Meant for labels that rarely change; text drawn with
+ * fallback placeholders is not kept. */
+int
+drw_textcached(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert)
+{
+	Drawable drawable;
+	unsigned int i, victim = 0, ph;
+
+	if (!drw || !drw->scheme || !w || !h || !text || !drw->fonts)
+		return drw_text(drw, x, y, w, h, lpad, text, invert);
+
+	for (i = 0; i < textcache_len; i++) {
+		if (textcache[i].text && textcache[i].scheme == drw->scheme &&
+		    textcache[i].invert == invert && textcache[i].w == w &&
+		    textcache[i].h == h && textcache[i].lpad == lpad &&
+		    !strcmp(textcache[i].text, text))
+			break;
+		if (textcache[i].used < textcache[victim].used)
+			victim = i;
+	}
+	if (i == textcache_len) {
+		i = victim;
+		if (textcache[i].text) {
+			XFreePixmap(drw->dpy, textcache[i].pixmap);
+			free(textcache[i].text);
+			textcache[i].text = NULL;
+		}
+		textcache[i].pixmap = XCreatePixmap(drw->dpy, drw->root, w, h,
+		                                    DefaultDepth(drw->dpy, drw->screen));
+		drawable = drw->drawable;
+		drw->drawable = textcache[i].pixmap;
+		ph = drw->placeholders;
+		drw_text(drw, 0, 0, w, h, lpad, text, invert);
+		drw->drawable = drawable;
+		if (drw->placeholders == ph && (textcache[i].text = strdup(text))) {
+			textcache[i].scheme = drw->scheme;
+			textcache[i].invert = invert;
+			textcache[i].w = w;
+			textcache[i].h = h;
+			textcache[i].lpad = lpad;
+		} else {
+			XCopyArea(drw->dpy, textcache[i].pixmap, drw->drawable, drw->gc, 0, 0, w, h, x, y);
+			XFreePixmap(drw->dpy, textcache[i].pixmap);
+			return x + w;
+		}
+	}
+	textcache[i].used = ++textcacheclock;
+	XCopyArea(drw->dpy, textcache[i].pixmap, drw->drawable, drw->gc, 0, 0, w, h, x, y);
+	return x + w;
+}
+
+/* Drops all cached text, e.g. after fonts or scheme colors changed. */
+void
+drw_textcache_clear(Drw *drw)
+{
+	unsigned int i;
+
+	if (!drw)
+		return;
+	for (i = 0; i < textcache_len; i++) {
+		if (!textcache[i].text)
+			continue;
+		XFreePixmap(drw->dpy, textcache[i].pixmap);
+		free(textcache[i].text);
+		textcache[i].text = NULL;
+		textcache[i].used = 0;
+	}
+}
+
 void
 drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h)
 {
@@ -14,6 +14,7 @@ typedef struct Fnt {
 	unsigned int h;
 	XftFont *xfont;
 	FcPattern *pattern;
+	short advance[128]; /* of the ASCII glyphs, -1 if missing, all 0 until measured */
 	struct Fnt *next;
 } Fnt;
 
@@ -29,6 +30,7 @@ typedef struct {
 	GC gc;
 	Clr *scheme;
 	Fnt *fonts;
+	unsigned int placeholders; /* glyphs drawn while a fallback is pending */
 } Drw;
 
 /* Drawable abstraction */
@@ -42,6 +44,11 @@ void drw_fontset_free(Fnt* set);
 unsigned int drw_fontset_getwidth(Drw *drw, const char *text);
 unsigned int drw_fontset_getwidth_clamp(Drw *drw, const char *text, unsigned int n);
 void drw_font_getexts(Fnt *font, const char *text, unsigned int len, unsigned int *w, unsigned int *h);
+void drw_fontcache_load(Drw *drw, const char *path);
+void drw_fontcache_save(Drw *drw, const char *path);
+int drw_fallback_start(Drw *drw);
+void drw_fallback_stop(Drw *drw);
+int drw_fallback_collect(Drw *drw);
 
 /* Colorscheme abstraction */
 void drw_clr_create(Drw *drw, Clr *dest, const char *clrname);
@@ -58,6 +65,8 @@ void drw_setscheme(Drw *drw, Clr *scm);
 /* Drawing functions */
 void drw_rect(Drw *drw, int x, int y, unsigned int w, unsigned int h, int filled, int invert);
 int drw_text(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
+int drw_textcached(Drw *drw, int x, int y, unsigned int w, unsigned int h, unsigned int lpad, const char *text, int invert);
+void drw_textcache_clear(Drw *drw);
 
 /* Map functions */
 void drw_map(Drw *drw, Window win, int x, int y, unsigned int w, unsigned int h);
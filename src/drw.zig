@@ -18,6 +18,7 @@ pub const Fnt = extern struct {
     h: c_uint,
     xfont: ?*XftFont,
     pattern: ?*FcPattern,
+    advance: [128]c_short,
     next: ?*Fnt,
 };
 
@@ -38,6 +39,7 @@ pub const Drw = extern struct {
     gc: GC,
     scheme: ?*Clr,
     fonts: ?*Fnt,
+    placeholders: c_uint,
 };
 
 const drw = struct {
@@ -49,6 +51,11 @@ const drw = struct {
     extern fn drw_fontset_getwidth(drw: ?*Drw, text: [*:0]const u8) c_uint;
     extern fn drw_fontset_getwidth_clamp(drw: ?*Drw, text: [*:0]const u8, n: c_uint) c_uint;
     extern fn drw_font_getexts(font: ?*Fnt, text: [*:0]const u8, len: c_uint, w: ?*c_uint, h: ?*c_uint) void;
+    extern fn drw_fontcache_load(drw: ?*Drw, path: [*:0]const u8) void;
+    extern fn drw_fontcache_save(drw: ?*Drw, path: [*:0]const u8) void;
+    extern fn drw_fallback_start(drw: ?*Drw) c_int;
+    extern fn drw_fallback_stop(drw: ?*Drw) void;
+    extern fn drw_fallback_collect(drw: ?*Drw) c_int;
     extern fn drw_clr_create(drw: ?*Drw, dest: ?*Clr, clrname: [*:0]const u8) void;
     extern fn drw_scm_create(drw: ?*Drw, clrnames: [*][*:0]const u8, clrcount: usize) ?*Clr;
     extern fn drw_cur_create(drw: *Drw, shape: c_int) ?*Cur;
@@ -57,6 +64,8 @@ const drw = struct {
     extern fn drw_setscheme(drw: ?*Drw, scm: ?*Clr) void;
     extern fn drw_rect(drw: ?*Drw, x: c_int, y: c_int, w: c_uint, h: c_uint, filled: c_int, invert: c_int) void;
     extern fn drw_text(drw: ?*Drw, x: c_int, y: c_int, w: c_uint, h: c_uint, lpad: c_uint, text: [*:0]const u8, invert: c_int) c_int;
+    extern fn drw_textcached(drw: ?*Drw, x: c_int, y: c_int, w: c_uint, h: c_uint, lpad: c_uint, text: [*:0]const u8, invert: c_int) c_int;
+    extern fn drw_textcache_clear(drw: ?*Drw) void;
     extern fn drw_map(drw: ?*Drw, win: Window, x: c_int, y: c_int, w: c_uint, h: c_uint) void;
 };
 
@@ -70,6 +79,15 @@ pub const fontset = struct {
     pub const getWidthClamp = drw.drw_fontset_getwidth_clamp;
 };
 pub const fontGetExts = drw.drw_font_getexts;
+pub const fontcache = struct {
+    pub const load = drw.drw_fontcache_load;
+    pub const save = drw.drw_fontcache_save;
+};
+pub const fallback = struct {
+    pub const start = drw.drw_fallback_start;
+    pub const stop = drw.drw_fallback_stop;
+    pub const collect = drw.drw_fallback_collect;
+};
 pub const clrCreate = drw.drw_clr_create;
 pub const scmCreate = drw.drw_scm_create;
 pub const cur = struct {
@@ -80,4 +98,6 @@ pub const setFontSet = drw.drw_setfontset;
 pub const setScheme = drw.drw_setscheme;
 pub const rect = drw.drw_rect;
 pub const text = drw.drw_text;
+pub const textCached = drw.drw_textcached;
+pub const textCacheClear = drw.drw_textcache_clear;
 pub const map = drw.drw_map;
@@ -20,6 +20,7 @@
  *
  * To understand everything else, start reading main().
  */
+#define _GNU_SOURCE /* for POSIX_SPAWN_SETSID of glibc */
 
 #include <X11/Xatom.h>
 #include <X11/Xlib.h>
@@ -28,21 +29,35 @@
 #include <X11/cursorfont.h>
 #include <X11/keysym.h>
 #include <errno.h>
+#include <fcntl.h>
 #include <locale.h>
 #include <signal.h>
+#include <spawn.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 #ifdef XINERAMA
 #include <X11/extensions/Xinerama.h>
 #endif /* XINERAMA */
+#ifdef XCB
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#endif /* XCB */
 #include <X11/Xft/Xft.h>
 
 #include "dwm.h"
+#include "grid.h"
+#include "ipc.h"
+#include "layout.h"
+#include "loop.h"
+#include "shm.h"
+#include "status.h"
 #include "util.h"
 
 /* macros */
@@ -57,24 +72,44 @@
 #define ISVISIBLE(C) ((C->tags & C->mon->tagset[C->mon->seltags]))
 #define LENGTH(X) (sizeof X / sizeof X[0])
 #define MOUSEMASK (BUTTONMASK | PointerMotionMask)
+#define ROOTMASK                                                               \
+  (SubstructureRedirectMask | SubstructureNotifyMask | ButtonPressMask |       \
+   StructureNotifyMask | PropertyChangeMask) /* see updaterootmask() */
+#define CLIENTMASK                                                             \
+  (FocusChangeMask | PropertyChangeMask | StructureNotifyMask |                \
+   (focusfollowsmouse ? EnterWindowMask : 0))
 #define WIDTH(X) ((X)->w + 2 * (X)->bw)
 #define HEIGHT(X) ((X)->h + 2 * (X)->bw)
 #define TAGMASK ((1 << LENGTH(tags)) - 1)
+#define GRIDCELL 128 /* px, cell size of the spatial indexes */
 #define TEXTW(X) (drw_fontset_getwidth(drw, (X)) + lrpad)
+#define STATEVERSION 1 /* of the SavedState records */
+
+#ifdef POSIX_SPAWN_SETSID
+#define SPAWNFLAGS (POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK)
+#else /* children stay in the session of dwm */
+#define SPAWNFLAGS POSIX_SPAWN_SETSIGMASK
+#endif
 
 /* enums */
 enum { CurNormal, CurResize, CurMove, CurLast }; /* cursor */
-enum { SchemeNorm, SchemeSel };                  /* color schemes */
+enum { ThrottleTitle, ThrottleHints, ThrottleLast }; /* throttled updates */
 enum {
   NetSupported,
   NetWMName,
   NetWMState,
   NetWMCheck,
   NetWMFullscreen,
+  NetWMHidden,
+  NetWMPid,
   NetActiveWindow,
   NetWMWindowType,
   NetWMWindowTypeDialog,
   NetClientList,
+  NetNumberOfDesktops,
+  NetCurrentDesktop,
+  NetDesktopNames,
+  NetWMDesktop,
   NetLast
 }; /* EWMH atoms */
 enum {
@@ -82,18 +117,32 @@ enum {
   WMDelete,
   WMState,
   WMTakeFocus,
+  WMTags, /* _DWM_TAGS, the tag mask of a client */
   WMLast
 
 }; /* default atoms */
 enum {
-  ClkTagBar,
-  ClkLtSymbol,
-  ClkStatusText,
-  ClkWinTitle,
-  ClkClientWin,
-  ClkRootWin,
-  ClkLast
-}; /* clicks */
+  DirtyLayout = 1 << 0,     /* tiling has to be recomputed */
+  DirtyVisibility = 1 << 1, /* clients have to be shown or hidden */
+  DirtyStack = 1 << 2,      /* restack, which redraws the bar as well */
+  DirtyBar = 1 << 3,        /* bar contents */
+  DirtyBarPos = 1 << 4,     /* bar window geometry */
+  DirtyAll = (1 << 5) - 1
+}; /* per-monitor pending work, done by arrangedirty() */
+enum { BarTitle = 1 << 0, BarStatus = 1 << 1, BarTags = 1 << 2 }; /* bar segments */
+#ifdef XCB
+enum {
+  PropNetWMName,
+  PropWMName,
+  PropWMClass,
+  PropTransient,
+  PropNormalHints,
+  PropWMHints,
+  PropNetWMState,
+  PropNetWMWindowType,
+  PropLast
+}; /* properties manage() fetches in one batch */
+#endif /* XCB */
 static int screen;
 struct internal_state {
   Display *dpy;
@@ -128,10 +177,42 @@ static Atom wmatom[WMLast], netatom[NetLast];
 static int running = 1;
 static Cur *cursor[CurLast];
 static Clr **scheme;
+static Clr ***palette; /* scheme tables of palettes[] */
+static unsigned int curpalette;
 
 Drw *drw;
 static Monitor *mons, *selmon;
 static Window root, wmcheckwin;
+static Ipc *ipc;
+static Shm *shm;
+static int batching; /* open ipc transactions, or adopting restored windows */
+static char **dwmargv;     /* re-executed by restart() */
+static int restarting;
+static SavedClient *saved; /* clients handed over by the previous process */
+static unsigned int nsaved;
+static char fontcache[512]; /* resolved fonts, kept across restarts */
+static Timer bartimer;      /* rate limits flushbars() */
+static long long lastbar;
+static Timer focustimer;    /* delays focus by enternotify() */
+static Window focuswin;
+static Grid *mongrid;       /* monitor areas, rebuilt by updategeom() */
+static Grid *wingrid;       /* visible clients, see clientgrid() */
+static int wingridstale;
+static Client *dragged;     /* left stale in wingrid, see movemouse() */
+static PoolEnt *pool;       /* poolsize instances of each of poolcmds */
+static Launch launches[8];  /* pooled commands started on a miss */
+static IpcMetrics metrics;
+static unsigned char *snapbuf; /* built by updatesnapshot() */
+static size_t snapcap;
+static Client **tiled;        /* clients being arranged, see tiledclients() */
+static LayoutClient *tiledlc;
+static LayoutRect *tiledr;
+static unsigned int ntiled;
+static int statusfd = -1; /* stext comes from status.c if >= 0 */
+static int fsmode;          /* see updatefsmode() */
+static long rootmask;       /* selected on root, see updaterootmask() */
+
+extern char **environ;
 
 /* configuration, allows nested code to access above variables */
 #include "config.h"
@@ -142,110 +223,77 @@ struct NumTags {
 };
 
 /* function implementations */
-void applyrules(program_state *state, Client *c) {
+/* XFree() of memory counted by alloc_count() */
+static void xfree(void *p) {
+  alloc_forget(p);
+  XFree(p);
+}
 
-  const char *class, *instance;
-  unsigned int i;
-  const Rule *r;
-  Monitor *m;
+void applyrules(program_state *state, Client *c) {
   XClassHint ch = {NULL, NULL};
 
-  /* rule matching */
-  c->isfloating = 0;
-  c->tags = 0;
   XGetClassHint(state->dpy, c->win, &ch);
-  class = ch.res_class ? ch.res_class : broken;
-  instance = ch.res_name ? ch.res_name : broken;
-
-  for (i = 0; i < LENGTH(rules); i++) {
-    r = &rules[i];
-    if ((!r->title || strstr(c->name, r->title)) &&
-        (!r->class || strstr(class, r->class)) &&
-        (!r->instance || strstr(instance, r->instance))) {
-      c->isfloating = r->isfloating;
-      c->tags |= r->tags;
-      for (m = mons; m && m->num != r->monitor; m = m->next)
-        ;
-      if (m)
-        c->mon = m;
-    }
-  }
+  alloc_count(ch.res_class, "XGetClassHint");
+  alloc_count(ch.res_name, "XGetClassHint");
+  matchrules(c, ch.res_class ? ch.res_class : broken,
+             ch.res_name ? ch.res_name : broken);
   if (ch.res_class)
-    XFree(ch.res_class);
+    xfree(ch.res_class);
   if (ch.res_name)
-    XFree(ch.res_name);
-  c->tags =
-      c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
+    xfree(ch.res_name);
+}
+
+/* describes c to the functions of layout.c */
+static void layoutclient(program_state *state, Client *c, LayoutClient *lc) {
+  lc->usehints =
+      resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange;
+  if (lc->usehints && !c->hintsvalid)
+    updatesizehints(state, c);
+  lc->x = c->x;
+  lc->y = c->y;
+  lc->w = c->w;
+  lc->h = c->h;
+  lc->bw = c->bw;
+  lc->basew = c->basew;
+  lc->baseh = c->baseh;
+  lc->incw = c->incw;
+  lc->inch = c->inch;
+  lc->maxw = c->maxw;
+  lc->maxh = c->maxh;
+  lc->minw = c->minw;
+  lc->minh = c->minh;
+  lc->mina = c->mina;
+  lc->maxa = c->maxa;
 }
 
 int applysizehints(program_state *state, Client *c, int *x, int *y, int *w,
                    int *h, int interact) {
-  int baseismin;
-  Monitor *m = c->mon;
-
-  /* set minimum possible */
-  *w = MAX(1, *w);
-  *h = MAX(1, *h);
-  if (interact) {
-    if (*x > sw)
-      *x = sw - WIDTH(c);
-    if (*y > sh)
-      *y = sh - HEIGHT(c);
-    if (*x + *w + 2 * c->bw < 0)
-      *x = 0;
-    if (*y + *h + 2 * c->bw < 0)
-      *y = 0;
-  } else {
-    if (*x >= m->wx + m->ww)
-      *x = m->wx + m->ww - WIDTH(c);
-    if (*y >= m->wy + m->wh)
-      *y = m->wy + m->wh - HEIGHT(c);
-    if (*x + *w + 2 * c->bw <= m->wx)
-      *x = m->wx;
-    if (*y + *h + 2 * c->bw <= m->wy)
-      *y = m->wy;
-  }
-  if (*h < bh)
-    *h = bh;
-  if (*w < bh)
-    *w = bh;
-  if (resizehints || c->isfloating || !c->mon->lt[c->mon->sellt]->arrange) {
-    if (!c->hintsvalid)
-      updatesizehints(state, c);
-    /* see last two sentences in ICCCM 4.1.2.3 */
-    baseismin = c->basew == c->minw && c->baseh == c->minh;
-    if (!baseismin) { /* temporarily remove base dimensions */
-      *w -= c->basew;
-      *h -= c->baseh;
-    }
-    /* adjust for aspect limits */
-    if (c->mina > 0 && c->maxa > 0) {
-      if (c->maxa < (float)*w / *h)
-        *w = *h * c->maxa + 0.5;
-      else if (c->mina < (float)*h / *w)
-        *h = *w * c->mina + 0.5;
-    }
-    if (baseismin) { /* increment calculation requires this */
-      *w -= c->basew;
-      *h -= c->baseh;
-    }
-    /* adjust for increment value */
-    if (c->incw)
-      *w -= *w % c->incw;
-    if (c->inch)
-      *h -= *h % c->inch;
-    /* restore base dimensions */
-    *w = MAX(*w + c->basew, c->minw);
-    *h = MAX(*h + c->baseh, c->minh);
-    if (c->maxw)
-      *w = MIN(*w, c->maxw);
-    if (c->maxh)
-      *h = MIN(*h, c->maxh);
-  }
-  return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
+  LayoutClient lc;
+  LayoutRect r = {*x, *y, *w, *h};
+  LayoutRect bounds = {c->mon->wx, c->mon->wy, c->mon->ww, c->mon->wh};
+  int changed;
+
+  if (interact)
+    bounds = (LayoutRect){0, 0, sw, sh};
+  layoutclient(state, c, &lc);
+  changed = layout_hints(&lc, &bounds, interact, bh, &r);
+  *x = r.x;
+  *y = r.y;
+  *w = r.w;
+  *h = r.h;
+  return changed;
 }
 
 void arrange(program_state *state, Monitor *m) {
+  wingridstale = 1;
+  if (batching) {
+    if (m)
+      m->dirty |= DirtyLayout | DirtyVisibility | DirtyStack;
+    else
+      for (m = mons; m; m = m->next)
+        m->dirty |= DirtyLayout | DirtyVisibility;
+    return;
+  }
   if (m)
     showhide(state, m->stack);
   else
@@ -259,6 +307,30 @@ void arrange(program_state *state, Monitor *m) {
       arrangemon(state, m);
 }
 
+/* Does the work marked in each monitor's dirty mask, once per monitor and
+ * only for those monitors. Deferred while batching. */
+void arrangedirty(program_state *state) {
+  Monitor *m;
+
+  if (batching)
+    return;
+  wingridstale = 1;
+  for (m = mons; m; m = m->next)
+    if (m->dirty & DirtyBarPos)
+      XMoveResizeWindow(state->dpy, m->barwin, m->wx, m->by, m->ww, bh);
+  for (m = mons; m; m = m->next)
+    if (m->dirty & DirtyVisibility)
+      showhide(state, m->stack);
+  for (m = mons; m; m = m->next)
+    if (m->dirty & DirtyLayout)
+      arrangemon(state, m);
+  for (m = mons; m; m = m->next) {
+    if (m->dirty & DirtyStack)
+      restack(state, m);
+    m->dirty &= DirtyBar; /* left to flushbars() */
+  }
+}
+
 void arrangemon(program_state *state, Monitor *m) {
   strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
   if (m->lt[m->sellt]->arrange)
@@ -335,22 +407,48 @@ void cleanup(program_state *state) {
   Arg a = {.ui = ~0};
   Layout foo = {"", NULL};
   Monitor *m;
-  size_t i;
+  size_t i, p;
 
-  view(state, &a);
-  selmon->lt[selmon->sellt] = &foo;
-  for (m = mons; m; m = m->next)
-    while (m->stack)
-      unmanage(state, m->stack, 0);
+  if (restarting) {
+    /* windows stay as they are for the next process to take over */
+    savestate(state);
+  } else {
+    view(state, &a);
+    selmon->lt[selmon->sellt] = &foo;
+    for (m = mons; m; m = m->next)
+      while (m->stack)
+        unmanage(state, m->stack, 0);
+  }
   XUngrabKey(state->dpy, AnyKey, AnyModifier, root);
   while (mons)
     cleanupmon(state, mons);
   for (i = 0; i < CurLast; i++)
     drw_cur_free(drw, cursor[i]);
-  for (i = 0; i < LENGTH(colors); i++)
-    free(scheme[i]);
-  free(scheme);
+  for (p = 0; p < LENGTH(palettes); p++) {
+    for (i = 0; i < LENGTH(colors); i++)
+      free(palette[p][i]);
+    free(palette[p]);
+  }
+  free(palette);
   XDestroyWindow(state->dpy, wmcheckwin);
+  /* instances nobody adopted, a restart starts its own */
+  for (i = 0; i < LENGTH(poolcmds) * poolsize; i++)
+    if (pool[i].pid)
+      kill(pool[i].pid, SIGTERM);
+  free(pool);
+  ipc_free(ipc);
+  if (statusfd >= 0)
+    loop_unwatch(statusfd);
+  status_stop();
+  shm_free(shm);
+  free(snapbuf);
+  grid_free(mongrid);
+  grid_free(wingrid);
+  free(tiled);
+  free(tiledlc);
+  free(tiledr);
+  loop_free();
+  drw_fontcache_save(drw, fontcache);
   drw_free(drw);
   XSync(state->dpy, False);
   XSetInputFocus(state->dpy, PointerRoot, RevertToPointerRoot, CurrentTime);
@@ -424,14 +522,15 @@ void configurenotify(program_state *state, XEvent *e) {
     if (updategeom(state) || dirty) {
       drw_resize(drw, sw, bh);
       updatebars(state);
-      for (m = mons; m; m = m->next) {
-        for (c = m->clients; c; c = c->next)
-          if (c->isfullscreen)
-            resizeclient(state, c, m->mx, m->my, m->mw, m->mh);
-        XMoveResizeWindow(state->dpy, m->barwin, m->wx, m->by, m->ww, bh);
-      }
+      /* only the monitors updategeom() marked are touched */
+      for (m = mons; m; m = m->next)
+        if (m->dirty & DirtyBarPos)
+          for (c = m->clients; c; c = c->next)
+            if (c->isfullscreen)
+              resizeclient(state, c, m->mx, m->my, m->mw, m->mh);
+      updaterootmask(state);
       focus(state, NULL);
-      arrange(state, NULL);
+      arrangedirty(state);
     }
   }
 }
@@ -488,6 +587,25 @@ void configurerequest(program_state *state, XEvent *e) {
   XSync(state->dpy, False);
 }
 
+/* name->value need not be NUL-terminated, name->nitems bounds it */
+void copytextprop(program_state *state, XTextProperty *name, char *text,
+                  unsigned int size) {
+  char **list = NULL;
+  int n;
+
+  if (name->encoding == XA_STRING) {
+    n = MIN(name->nitems, size - 1);
+    memcpy(text, name->value, n);
+    text[n] = '\0';
+  } else if (XmbTextPropertyToTextList(state->dpy, name, &list, &n) >=
+                 Success &&
+             n > 0 && *list) {
+    strncpy(text, *list, size - 1);
+    XFreeStringList(list);
+  }
+  text[size - 1] = '\0';
+}
+
 Monitor *createmon(void) {
   Monitor *m;
 
@@ -506,9 +624,14 @@ Monitor *createmon(void) {
 void destroynotify(program_state *state, XEvent *e) {
   Client *c;
   XDestroyWindowEvent *ev = &e->xdestroywindow;
+  unsigned int i;
 
   if ((c = wintoclient(ev->window)))
     unmanage(state, c, 1);
+  else
+    for (i = 0; i < LENGTH(poolcmds) * poolsize; i++)
+      if (pool[i].win == ev->window)
+        pool[i].pid = pool[i].win = 0; /* started again on the next spawn() */
 }
 
 void detach(Client *c) {
@@ -552,17 +675,19 @@ void drawbar(Monitor *m) {
   int x, w, tw = 0;
   int boxs = drw->fonts->h / 9;
   int boxw = drw->fonts->h / 6 + 2;
-  unsigned int i, occ = 0, urg = 0;
+  unsigned int i, occ = 0, urg = 0, ph;
   Client *c;
 
+  m->dirty &= ~DirtyBar;
   if (!m->showbar)
     return;
 
+  m->placeholders = 0;
   /* draw status first so it can be overdrawn by tags later */
   if (m == selmon) { /* status is only drawn on selected monitor */
-    drw_setscheme(drw, scheme[SchemeNorm]);
     tw = TEXTW(stext) - lrpad + 2; /* 2px right padding */
-    drw_text(drw, m->ww - tw, 0, tw, bh, 0, stext, 0);
+    m->statusw = tw;
+    drawstatus(m);
   }
 
   for (c = m->clients; c; c = c->next) {
@@ -571,11 +696,12 @@ void drawbar(Monitor *m) {
       urg |= c->tags;
   }
   x = 0;
+  ph = drw->placeholders;
   for (i = 0; i < LENGTH(tags); i++) {
     w = TEXTW(tags[i]);
     drw_setscheme(
         drw, scheme[m->tagset[m->seltags] & 1 << i ? SchemeSel : SchemeNorm]);
-    drw_text(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
+    drw_textcached(drw, x, 0, w, bh, lrpad / 2, tags[i], urg & 1 << i);
     if (occ & 1 << i)
       drw_rect(drw, x + boxs, boxs, boxw, boxw,
                m == selmon && selmon->sel && selmon->sel->tags & 1 << i,
@@ -584,39 +710,54 @@ void drawbar(Monitor *m) {
   }
   w = TEXTW(m->ltsymbol);
   drw_setscheme(drw, scheme[SchemeNorm]);
-  x = drw_text(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+  x = drw_textcached(drw, x, 0, w, bh, lrpad / 2, m->ltsymbol, 0);
+  if (drw->placeholders != ph)
+    m->placeholders |= BarTags;
 
+  m->titlex = x;
+  m->titlew = 0;
   if ((w = m->ww - tw - x) > bh) {
-    if (m->sel) {
-      drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
-      drw_text(drw, x, 0, w, bh, lrpad / 2, m->sel->name, 0);
-      if (m->sel->isfloating)
-        drw_rect(drw, x + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
-    } else {
-      drw_setscheme(drw, scheme[SchemeNorm]);
-      drw_rect(drw, x, 0, w, bh, 1, 1);
-    }
+    m->titlew = w;
+    drawtitle(m);
   }
   drw_map(drw, m->barwin, 0, 0, m->ww, bh);
 }
 
-void drawbars(void) {
-  Monitor *m;
+void drawstatus(Monitor *m) {
+  unsigned int ph = drw->placeholders;
 
-  for (m = mons; m; m = m->next)
-    drawbar(m);
+  drw_setscheme(drw, scheme[SchemeNorm]);
+  drw_text(drw, m->ww - m->statusw, 0, m->statusw, bh, 0, stext, 0);
+  if (drw->placeholders != ph)
+    m->placeholders |= BarStatus;
 }
 
-void enternotify(program_state *state, XEvent *e) {
+void drawtitle(Monitor *m) {
+  int boxs = drw->fonts->h / 9;
+  int boxw = drw->fonts->h / 6 + 2;
+  unsigned int ph = drw->placeholders;
+
+  if (m->sel) {
+    drw_setscheme(drw, scheme[m == selmon ? SchemeSel : SchemeNorm]);
+    drw_text(drw, m->titlex, 0, m->titlew, bh, lrpad / 2, m->sel->name, 0);
+    if (m->sel->isfloating)
+      drw_rect(drw, m->titlex + boxs, boxs, boxw, boxw, m->sel->isfixed, 0);
+  } else {
+    drw_setscheme(drw, scheme[SchemeNorm]);
+    drw_rect(drw, m->titlex, 0, m->titlew, bh, 1, 1);
+  }
+  if (drw->placeholders != ph)
+    m->placeholders |= BarTitle;
+}
+
+/* focuses the window the pointer entered last */
+static void enterfocus(void *arg) {
+  program_state *state = arg;
   Client *c;
   Monitor *m;
-  XCrossingEvent *ev = &e->xcrossing;
 
-  if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) &&
-      ev->window != root)
-    return;
-  c = wintoclient(ev->window);
-  m = c ? c->mon : wintomon(state, ev->window);
+  c = wintoclient(focuswin);
+  m = c ? c->mon : wintomon(state, focuswin);
   if (m != selmon) {
     unfocus(state, selmon->sel, 1);
     selmon = m;
@@ -625,16 +766,193 @@ void enternotify(program_state *state, XEvent *e) {
   focus(state, c);
 }
 
+/* Pointer focus waits until the pointer rested focusdwell ms on a window,
+ * so sweeping across windows only focuses the one it stops on. */
+void enternotify(program_state *state, XEvent *e) {
+  XCrossingEvent *ev = &e->xcrossing;
+
+  if ((ev->mode != NotifyNormal || ev->detail == NotifyInferior) &&
+      ev->window != root)
+    return;
+  focuswin = ev->window;
+  if (focusdwell)
+    timer_start(&focustimer, focusdwell, enterfocus, state);
+  else
+    enterfocus(state);
+}
+
 void expose(program_state *state, XEvent *e) {
   Monitor *m;
   XExposeEvent *ev = &e->xexpose;
 
   if (ev->count == 0 && (m = wintomon(state, ev->window)))
-    drawbar(m);
+    invalidatebar(m);
+}
+
+#ifdef XCB
+/* Sends every property request manage() needs before waiting for the first
+ * reply, so adopting a window costs one round-trip instead of one per
+ * property. Missing properties and vanished windows leave a NULL reply. */
+static void fetchprops(program_state *state, Window w,
+                       xcb_get_property_reply_t *reply[PropLast]) {
+  xcb_connection_t *xc = XGetXCBConnection(state->dpy);
+  xcb_get_property_cookie_t cookie[PropLast];
+  xcb_generic_error_t *err;
+  const struct {
+    Atom atom;
+    uint32_t len; /* in 32-bit units */
+  } props[PropLast] = {
+      [PropNetWMName] = {netatom[NetWMName], 256},
+      [PropWMName] = {XA_WM_NAME, 256},
+      [PropWMClass] = {XA_WM_CLASS, 128},
+      [PropTransient] = {XA_WM_TRANSIENT_FOR, 1},
+      [PropNormalHints] = {XA_WM_NORMAL_HINTS, 18},
+      [PropWMHints] = {XA_WM_HINTS, 9},
+      [PropNetWMState] = {netatom[NetWMState], 1},
+      [PropNetWMWindowType] = {netatom[NetWMWindowType], 1},
+  };
+  int i;
+
+  for (i = 0; i < PropLast; i++)
+    cookie[i] = xcb_get_property(xc, 0, w, props[i].atom,
+                                 XCB_GET_PROPERTY_TYPE_ANY, 0, props[i].len);
+  for (i = 0; i < PropLast; i++) {
+    err = NULL;
+    reply[i] = xcb_get_property_reply(xc, cookie[i], &err);
+    free(err);
+    if (reply[i] && (reply[i]->type == XCB_NONE ||
+                     !xcb_get_property_value_length(reply[i]))) {
+      free(reply[i]);
+      reply[i] = NULL;
+    }
+  }
+}
+
+/* mirrors XGetClassHint() followed by applyrules() */
+static void propclass(xcb_get_property_reply_t *r, Client *c) {
+  char buf[128 * 4 + 2];
+  const char *class = broken, *instance = broken;
+  int n;
+
+  if (r && r->type == XA_STRING && r->format == 8) {
+    n = MIN(xcb_get_property_value_length(r), (int)sizeof buf - 2);
+    memcpy(buf, xcb_get_property_value(r), n);
+    buf[n] = buf[n + 1] = '\0';
+    instance = buf;
+    class = buf + strlen(buf) + 1;
+  }
+  matchrules(c, class, instance);
+}
+
+/* returns the first 32-bit item of r if it is of type t and format 32 */
+static int propcard32(xcb_get_property_reply_t *r, Atom t, uint32_t *v) {
+  if (!r || r->type != t || r->format != 32 ||
+      xcb_get_property_value_length(r) < 4)
+    return 0;
+  *v = *(uint32_t *)xcb_get_property_value(r);
+  return 1;
+}
+
+static int proptext(program_state *state, xcb_get_property_reply_t *r,
+                    char *text, unsigned int size) {
+  XTextProperty name;
+
+  text[0] = '\0';
+  if (!r)
+    return 0;
+  name.value = xcb_get_property_value(r);
+  name.encoding = r->type;
+  name.format = r->format;
+  name.nitems = xcb_get_property_value_length(r) / (r->format / 8);
+  copytextprop(state, &name, text, size);
+  return 1;
+}
+
+/* mirrors XGetWMNormalHints() */
+static int propsizehints(xcb_get_property_reply_t *r, XSizeHints *size) {
+  int32_t *v;
+  int n;
+
+  if (!r || r->type != XA_WM_SIZE_HINTS || r->format != 32 ||
+      (n = xcb_get_property_value_length(r) / 4) < 15)
+    return 0;
+  v = xcb_get_property_value(r);
+  size->flags = (uint32_t)v[0];
+  size->min_width = v[5];
+  size->min_height = v[6];
+  size->max_width = v[7];
+  size->max_height = v[8];
+  size->width_inc = v[9];
+  size->height_inc = v[10];
+  size->min_aspect.x = v[11];
+  size->min_aspect.y = v[12];
+  size->max_aspect.x = v[13];
+  size->max_aspect.y = v[14];
+  if (n < 18) /* pre-ICCCM 1.0 clients have no base size */
+    size->flags &= ~(PBaseSize | PWinGravity);
+  else {
+    size->base_width = v[15];
+    size->base_height = v[16];
+  }
+  return 1;
+}
+
+/* mirrors XGetWMHints() */
+static int propwmhints(xcb_get_property_reply_t *r, XWMHints *wmh) {
+  int32_t *v;
+  int n;
+
+  if (!r || r->type != XA_WM_HINTS || r->format != 32 ||
+      (n = xcb_get_property_value_length(r) / 4) < 8)
+    return 0;
+  v = xcb_get_property_value(r);
+  wmh->flags = (uint32_t)v[0];
+  wmh->input = v[1];
+  wmh->initial_state = v[2];
+  wmh->icon_pixmap = (uint32_t)v[3];
+  wmh->icon_window = (uint32_t)v[4];
+  wmh->icon_x = v[5];
+  wmh->icon_y = v[6];
+  wmh->icon_mask = (uint32_t)v[7];
+  wmh->window_group = n < 9 ? 0 : (uint32_t)v[8];
+  return 1;
+}
+#endif /* XCB */
+
+static void barexpired(void *arg) { flushbars(); }
+
+/* whether the bar of m is covered by a fullscreen client and left alone */
+static int barcovered(Monitor *m) {
+  return fullscreenquiet && m->sel && m->sel->isfullscreen && ISVISIBLE(m->sel);
+}
+
+/* Draws the bars invalidated since the last call, at most once every
+ * barinterval ms. Called when the event queue ran empty. Covered bars stay
+ * invalid until they are uncovered. */
+void flushbars(void) {
+  Monitor *m;
+  long long now;
+
+  if (batching || bartimer.armed)
+    return;
+  for (m = mons; m && (!(m->dirty & DirtyBar) || barcovered(m)); m = m->next)
+    ;
+  if (!m)
+    return;
+  now = loop_now();
+  if (now - lastbar < barinterval) {
+    timer_start(&bartimer, barinterval - (now - lastbar), barexpired, NULL);
+    return;
+  }
+  lastbar = now;
+  for (m = mons; m; m = m->next)
+    if (m->dirty & DirtyBar && !barcovered(m))
+      drawbar(m);
 }
 
 void focus(program_state *state, Client *c) {
 
+  timer_stop(&focustimer); /* any other focus change wins over the pointer */
   if (!c || !ISVISIBLE(c))
     for (c = selmon->stack; c && !ISVISIBLE(c); c = c->snext)
       ;
@@ -655,7 +973,7 @@ void focus(program_state *state, Client *c) {
     XDeleteProperty(state->dpy, root, netatom[NetActiveWindow]);
   }
   selmon->sel = c;
-  drawbars();
+  invalidatebars();
 }
 
 /* there are some broken focus acquiring clients needing extra handling */
@@ -705,6 +1023,37 @@ void focusstack(program_state *state, const Arg *arg) {
   }
 }
 
+/* a fallback font arrived: redraw the bar segments that used placeholders */
+void fontready(int fd, void *arg) {
+  Monitor *m;
+  unsigned int segs;
+
+  if (!drw_fallback_collect(drw))
+    return;
+  for (m = mons; m; m = m->next) {
+    if (!(segs = m->placeholders) || !m->showbar || m->dirty & DirtyBar)
+      continue;
+    /* tag labels move everything right of them, and a wider or narrower
+     * status moves the title area */
+    if (segs & BarTags ||
+        (segs & BarStatus &&
+         (m != selmon || !m->titlew ||
+          (int)(TEXTW(stext) - lrpad + 2) != m->statusw))) {
+      invalidatebar(m);
+      continue;
+    }
+    m->placeholders = 0;
+    if (segs & BarStatus) {
+      drawstatus(m);
+      drw_map(drw, m->barwin, m->ww - m->statusw, 0, m->statusw, bh);
+    }
+    if (segs & BarTitle && m->titlew) {
+      drawtitle(m);
+      drw_map(drw, m->barwin, m->titlex, 0, m->titlew, bh);
+    }
+  }
+}
+
 Atom getatomprop(program_state *state, Client *c, Atom prop) {
 
   int di;
@@ -715,8 +1064,9 @@ Atom getatomprop(program_state *state, Client *c, Atom prop) {
   if (XGetWindowProperty(state->dpy, c->win, prop, 0L, sizeof atom, False,
                          XA_ATOM, &da, &di, &dl, &dl, &p) == Success &&
       p) {
+    alloc_count(p, "XGetWindowProperty");
     atom = *(Atom *)p;
-    XFree(p);
+    xfree(p);
   }
   return atom;
 }
@@ -740,33 +1090,29 @@ long getstate(program_state *state, Window w) {
                          wmatom[WMState], &real, &format, &n, &extra,
                          (unsigned char **)&p) != Success)
     return -1;
+  alloc_count(p, "XGetWindowProperty");
   if (n != 0)
     result = *p;
-  XFree(p);
+  xfree(p);
   return result;
 }
 
 int gettextprop(program_state *state, Window w, Atom atom, char *text,
                 unsigned int size) {
-  char **list = NULL;
-  int n;
   XTextProperty name;
 
   if (!text || size == 0)
     return 0;
   text[0] = '\0';
-  if (!XGetTextProperty(state->dpy, w, &name, atom) || !name.nitems)
+  if (!XGetTextProperty(state->dpy, w, &name, atom))
+    return 0;
+  alloc_count(name.value, "XGetTextProperty");
+  if (!name.nitems) {
+    xfree(name.value);
     return 0;
-  if (name.encoding == XA_STRING) {
-    strncpy(text, (char *)name.value, size - 1);
-  } else if (XmbTextPropertyToTextList(state->dpy, &name, &list, &n) >=
-                 Success &&
-             n > 0 && *list) {
-    strncpy(text, *list, size - 1);
-    XFreeStringList(list);
   }
-  text[size - 1] = '\0';
-  XFree(name.value);
+  copytextprop(state, &name, text, size);
+  xfree(name.value);
   return 1;
 }
 
@@ -803,6 +1149,7 @@ void grabkeys(program_state *state) {
     syms = XGetKeyboardMapping(state->dpy, start, end - start + 1, &skip);
     if (!syms)
       return;
+    alloc_count(syms, "XGetKeyboardMapping");
     for (k = start; k <= end; k++)
       for (i = 0; i < LENGTH(keys); i++)
         /* skip modifier codes, we do that ourselves */
@@ -810,7 +1157,7 @@ void grabkeys(program_state *state) {
           for (j = 0; j < LENGTH(modifiers); j++)
             XGrabKey(state->dpy, k, keys[i].mod | modifiers[j], root, True,
                      GrabModeAsync, GrabModeAsync);
-    XFree(syms);
+    xfree(syms);
   }
 }
 
@@ -819,6 +1166,153 @@ void incnmaster(program_state *state, const Arg *arg) {
   arrange(state, selmon);
 }
 
+void invalidatebar(Monitor *m) { m->dirty |= DirtyBar; }
+
+void invalidatebars(void) {
+  Monitor *m;
+
+  for (m = mons; m; m = m->next)
+    m->dirty |= DirtyBar;
+}
+
+static void ipcclients(int fd) {
+  IpcClient *r;
+  Client *c;
+  Monitor *m;
+  int n = 0;
+
+  for (m = mons; m; m = m->next)
+    for (c = m->clients; c; c = c->next)
+      n++;
+  r = ecalloc(MAX(n, 1), sizeof(IpcClient));
+  n = 0;
+  for (m = mons; m; m = m->next)
+    for (c = m->clients; c; c = c->next, n++) {
+      r[n].win = c->win;
+      r[n].tags = c->tags;
+      r[n].mon = m->num;
+      r[n].x = c->x;
+      r[n].y = c->y;
+      r[n].w = c->w;
+      r[n].h = c->h;
+      r[n].flags = (c->isfloating ? IpcFloating : 0) |
+                   (c->isfullscreen ? IpcFullscreen : 0) |
+                   (c->isurgent ? IpcUrgent : 0) |
+                   (c == selmon->sel ? IpcFocused : 0);
+    }
+  ipc_reply(fd, IpcGetClients, IpcOk, n, r, n * sizeof(IpcClient));
+  free(r);
+}
+
+static void ipcmonitors(int fd) {
+  IpcMonitor *r;
+  Monitor *m;
+  int n = 0;
+
+  for (m = mons; m; m = m->next)
+    n++;
+  r = ecalloc(n, sizeof(IpcMonitor));
+  for (n = 0, m = mons; m; m = m->next, n++) {
+    r[n].num = m->num;
+    r[n].mx = m->mx;
+    r[n].my = m->my;
+    r[n].mw = m->mw;
+    r[n].mh = m->mh;
+    r[n].wx = m->wx;
+    r[n].wy = m->wy;
+    r[n].ww = m->ww;
+    r[n].wh = m->wh;
+    r[n].tagset = m->tagset[m->seltags];
+    r[n].layout = m->lt[m->sellt] - layouts;
+    r[n].mfact = m->mfact;
+    r[n].nmaster = m->nmaster;
+    r[n].sel = m->sel ? m->sel->win : 0;
+    r[n].selected = m == selmon;
+    r[n].showbar = m->showbar;
+  }
+  ipc_reply(fd, IpcGetMonitors, IpcOk, n, r, n * sizeof(IpcMonitor));
+  free(r);
+}
+
+void ipccommand(void *arg, int fd, const IpcMsg *msg) {
+  static const struct {
+    void (*func)(program_state *, const Arg *);
+    char type; /* 'i', 'u', 'f' or 0 if the command takes no argument */
+  } cmds[IpcLast] = {
+      [IpcView] = {view, 'u'},
+      [IpcToggleView] = {toggleview, 'u'},
+      [IpcTag] = {tag, 'u'},
+      [IpcToggleTag] = {toggletag, 'u'},
+      [IpcFocusStack] = {focusstack, 'i'},
+      [IpcFocusMon] = {focusmon, 'i'},
+      [IpcTagMon] = {tagmon, 'i'},
+      [IpcIncNMaster] = {incnmaster, 'i'},
+      [IpcSetMFact] = {setmfact, 'f'},
+      [IpcZoom] = {zoom, 0},
+      [IpcKillClient] = {killclient, 0},
+      [IpcToggleFloating] = {togglefloating, 0},
+      [IpcToggleBar] = {togglebar, 0},
+      [IpcQuit] = {quit, 0},
+      [IpcRestart] = {restart, 0},
+  };
+  program_state *state = arg;
+  Arg a = {0};
+#ifdef ALLOCSTATS
+  AllocTotals at;
+#endif
+
+  switch (msg->op) {
+  case IpcBegin:
+    batching++;
+    break;
+  case IpcCommit:
+    if (!batching) {
+      ipc_reply(fd, msg->op, IpcErrOp, 0, NULL, 0);
+      return;
+    }
+    if (!--batching)
+      arrangedirty(state);
+    break;
+  case IpcGetMonitors:
+    ipcmonitors(fd);
+    return;
+  case IpcGetClients:
+    ipcclients(fd);
+    return;
+  case IpcGetMetrics:
+#ifdef ALLOCSTATS
+    alloc_totals(&at);
+    metrics.alloclive = at.live;
+    metrics.allocbytes = at.bytes;
+    metrics.allocpeak = at.peak;
+    metrics.heapbytes = at.heap;
+#endif
+    ipc_reply(fd, msg->op, IpcOk, 1, &metrics, sizeof metrics);
+    return;
+  case IpcSetLayout:
+    if (msg->arg.i >= (int)LENGTH(layouts)) {
+      ipc_reply(fd, msg->op, IpcErrArg, 0, NULL, 0);
+      return;
+    }
+    a.v = msg->arg.i < 0 ? NULL : &layouts[msg->arg.i];
+    setlayout(state, &a);
+    break;
+  default:
+    if (msg->op >= IpcLast || !cmds[msg->op].func) {
+      ipc_reply(fd, msg->op, IpcErrOp, 0, NULL, 0);
+      return;
+    }
+    if (cmds[msg->op].type == 'i')
+      a.i = msg->arg.i;
+    else if (cmds[msg->op].type == 'u')
+      a.ui = msg->arg.ui;
+    else if (cmds[msg->op].type == 'f')
+      a.f = msg->arg.f;
+    cmds[msg->op].func(state, &a);
+  }
+  ipc_reply(fd, msg->op, IpcOk, 0, NULL, 0);
+}
+
 #ifdef XINERAMA
 static int isuniquegeom(XineramaScreenInfo *unique, size_t n,
                         XineramaScreenInfo *info) {
@@ -857,13 +1351,99 @@ void killclient(program_state *state, const Arg *arg) {
   }
 }
 
+/* the index of all visible clients, rebuilt when anything moved */
+static Grid *clientgrid(void) {
+  Monitor *m;
+  Client *c;
+
+  if (!wingridstale)
+    return wingrid;
+  grid_clear(wingrid);
+  for (m = mons; m; m = m->next)
+    for (c = m->clients; c; c = c->next)
+      if (ISVISIBLE(c))
+        grid_insert(wingrid, c->x, c->y, WIDTH(c), HEIGHT(c), c);
+  wingridstale = 0;
+  return wingrid;
+}
+
+/* area of x, y, w, h covered by the floating windows of m other than c */
+static long overlap(Monitor *m, Client *c, int x, int y, int w, int h) {
+  const GridItem **hit;
+  Client *o;
+  long a = 0;
+  size_t i, n;
+
+  n = grid_query(clientgrid(), x, y, w, h, &hit);
+  for (i = 0; i < n; i++) {
+    o = hit[i]->data;
+    if (o != c && o->mon == m && (o->isfloating || !m->lt[m->sellt]->arrange))
+      a += (long)(MIN(x + w, hit[i]->x + hit[i]->w) - MAX(x, hit[i]->x)) *
+           (MIN(y + h, hit[i]->y + hit[i]->h) - MAX(y, hit[i]->y));
+  }
+  return a;
+}
+
+/* moves c to x, y, kept on its monitor, if it covers less there */
+static void tryplace(Client *c, int x, int y, long *best) {
+  Monitor *m = c->mon;
+  long a;
+
+  x = MAX(m->wx, MIN(x, m->wx + m->ww - WIDTH(c)));
+  y = MAX(m->wy, MIN(y, m->wy + m->wh - HEIGHT(c)));
+  if ((a = overlap(m, c, x, y, WIDTH(c), HEIGHT(c))) < *best || *best < 0) {
+    *best = a;
+    c->x = x;
+    c->y = y;
+  }
+}
+
+/* Puts a new floating window where it covers the least of the other
+ * floating windows: the top left corner or center of the monitor, or next
+ * to one of them. */
+static void placeclient(Client *c) {
+  Monitor *m = c->mon;
+  Client *o;
+  long best = -1;
+
+  tryplace(c, m->wx, m->wy, &best);
+  tryplace(c, m->wx + (m->ww - WIDTH(c)) / 2, m->wy + (m->wh - HEIGHT(c)) / 2,
+           &best);
+  for (o = m->clients; o && best; o = o->next)
+    if (o != c && ISVISIBLE(o) &&
+        (o->isfloating || !m->lt[m->sellt]->arrange)) {
+      tryplace(c, o->x + WIDTH(o), o->y, &best);
+      tryplace(c, o->x, o->y + HEIGHT(o), &best);
+      tryplace(c, o->x - WIDTH(c), o->y, &best);
+      tryplace(c, o->x, o->y - HEIGHT(c), &best);
+    }
+}
+
+static const SavedClient *savedclient(Window w) {
+  unsigned int i;
+
+  for (i = 0; i < nsaved; i++)
+    if (saved[i].win == w)
+      return &saved[i];
+  return NULL;
+}
+
 void manage(program_state *state, Window w, XWindowAttributes *wa) {
   Client *c, *t = NULL;
   Window trans = None;
   XWindowChanges wc;
+  const SavedClient *sc;
+#ifdef XCB
+  xcb_get_property_reply_t *prop[PropLast];
+  uint32_t wstate = None, wtype = None, v;
+  XSizeHints size;
+  XWMHints wmh;
+  int i;
+#endif /* XCB */
 
   c = ecalloc(1, sizeof(Client));
   c->win = w;
+  c->pubtags = ~0; /* not published yet, see updatedesktops() */
   /* geometry */
   c->x = c->oldx = wa->x;
   c->y = c->oldy = wa->y;
@@ -871,14 +1451,36 @@ void manage(program_state *state, Window w, XWindowAttributes *wa) {
   c->h = c->oldh = wa->height;
   c->oldbw = wa->border_width;
 
+#ifdef XCB
+  fetchprops(state, w, prop);
+  if (!proptext(state, prop[PropNetWMName], c->name, sizeof c->name))
+    proptext(state, prop[PropWMName], c->name, sizeof c->name);
+  if (c->name[0] == '\0') /* hack to mark broken clients */
+    strcpy(c->name, broken);
+  if (propcard32(prop[PropTransient], XA_WINDOW, &v))
+    trans = v;
+  if ((sc = savedclient(w)))
+    restoreclient(c, sc);
+  else if (trans != None && (t = wintoclient(trans))) {
+    c->mon = t->mon;
+    c->tags = t->tags;
+  } else {
+    c->mon = selmon;
+    propclass(prop[PropWMClass], c);
+  }
+#else
   updatetitle(state, c);
-  if (XGetTransientForHint(state->dpy, w, &trans) && (t = wintoclient(trans))) {
+  if ((sc = savedclient(w)))
+    restoreclient(c, sc);
+  else if (XGetTransientForHint(state->dpy, w, &trans) &&
+           (t = wintoclient(trans))) {
     c->mon = t->mon;
     c->tags = t->tags;
   } else {
     c->mon = selmon;
     applyrules(state, c);
   }
+#endif /* XCB */
 
   if (c->x + WIDTH(c) > c->mon->wx + c->mon->ww)
     c->x = c->mon->wx + c->mon->ww - WIDTH(c);
@@ -892,15 +1494,40 @@ void manage(program_state *state, Window w, XWindowAttributes *wa) {
   XConfigureWindow(state->dpy, w, CWBorderWidth, &wc);
   XSetWindowBorder(state->dpy, w, scheme[SchemeNorm][ColBorder].pixel);
   configure(state, c); /* propagates border_width, if size doesn't change */
+#ifdef XCB
+  propcard32(prop[PropNetWMState], XA_ATOM, &wstate);
+  propcard32(prop[PropNetWMWindowType], XA_ATOM, &wtype);
+  setwindowtype(state, c, wstate, wtype);
+  if (!propsizehints(prop[PropNormalHints], &size))
+    size.flags = PSize;
+  setsizehints(c, &size);
+  if (propwmhints(prop[PropWMHints], &wmh))
+    setwmhints(state, c, &wmh);
+  for (i = 0; i < PropLast; i++)
+    free(prop[i]);
+#else
   updatewindowtype(state, c);
   updatesizehints(state, c);
   updatewmhints(state, c);
-  XSelectInput(state->dpy, w,
-               EnterWindowMask | FocusChangeMask | PropertyChangeMask |
-                   StructureNotifyMask);
+#endif /* XCB */
+  XSelectInput(state->dpy, w, CLIENTMASK);
   grabbuttons(state, c, 0);
   if (!c->isfloating)
     c->isfloating = c->oldstate = trans != None || c->isfixed;
+  /* windows that left their position to us */
+  if (c->isfloating && !sc && trans == None && !c->haspos)
+    placeclient(c);
+  if (sc) {
+    c->isfloating = sc->isfloating;
+    c->oldstate = sc->oldstate;
+    c->oldbw = sc->oldbw;
+    if (c->isfullscreen) { /* setfullscreen() saved the fullscreen size */
+      c->oldx = sc->oldx;
+      c->oldy = sc->oldy;
+      c->oldw = sc->oldw;
+      c->oldh = sc->oldh;
+    }
+  }
   if (c->isfloating)
     XRaiseWindow(state->dpy, c->win);
   attach(c);
@@ -921,33 +1548,120 @@ void manage(program_state *state, Window w, XWindowAttributes *wa) {
 void mappingnotify(program_state *state, XEvent *e) {
   XMappingEvent *ev = &e->xmapping;
 
-  XRefreshKeyboardMapping(ev);
-  if (ev->request == MappingKeyboard)
-    grabkeys(state);
+  XRefreshKeyboardMapping(ev);
+  if (ev->request == MappingKeyboard)
+    grabkeys(state);
+}
+
+static long long usec(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+/* accounts a window mapped for a spawn() at t */
+static void mapped(long long t) {
+  long long us = usec() - t;
+
+  metrics.maps++;
+  metrics.maplast = us;
+  metrics.mapmax = MAX(metrics.mapmax, us);
+  metrics.maptotal += us;
+}
+
+void maprequest(program_state *state, XEvent *e) {
+  static XWindowAttributes wa;
+  XMapRequestEvent *ev = &e->xmaprequest;
+  unsigned int i;
+  pid_t pid = 0;
+
+  if (!XGetWindowAttributes(state->dpy, ev->window, &wa) ||
+      wa.override_redirect)
+    return;
+  if (wintoclient(ev->window))
+    return;
+  if (poolsize && (pid = winpid(state, ev->window)) &&
+      poolwithhold(ev->window, pid))
+    return;
+  manage(state, ev->window, &wa);
+  for (i = 0; pid && i < LENGTH(launches); i++)
+    if (launches[i].pid == pid) {
+      mapped(launches[i].t);
+      launches[i].pid = 0;
+    }
+}
+
+void matchrules(Client *c, const char *class, const char *instance) {
+  unsigned int i;
+  const Rule *r;
+  Monitor *m;
+
+  /* rule matching */
+  c->isfloating = 0;
+  c->tags = 0;
+  for (i = 0; i < LENGTH(rules); i++) {
+    r = &rules[i];
+    if ((!r->title || strstr(c->name, r->title)) &&
+        (!r->class || strstr(class, r->class)) &&
+        (!r->instance || strstr(instance, r->instance))) {
+      c->isfloating = r->isfloating;
+      c->tags |= r->tags;
+      for (m = mons; m && m->num != r->monitor; m = m->next)
+        ;
+      if (m)
+        c->mon = m;
+    }
+  }
+  c->tags =
+      c->tags & TAGMASK ? c->tags & TAGMASK : c->mon->tagset[c->mon->seltags];
+}
+
+/* collects the tiled clients of m into tiled[] and their descriptions */
+static unsigned int tiledclients(program_state *state, Monitor *m) {
+  unsigned int n = 0;
+  Client *c;
+
+  for (c = nexttiled(m->clients); c; c = nexttiled(c->next), n++) {
+    if (n == ntiled) {
+      ntiled = ntiled ? 2 * ntiled : 64;
+      tiled = erealloc(tiled, ntiled * sizeof(Client *));
+      tiledlc = erealloc(tiledlc, ntiled * sizeof(LayoutClient));
+      tiledr = erealloc(tiledr, ntiled * sizeof(LayoutRect));
+    }
+    tiled[n] = c;
+    layoutclient(state, c, &tiledlc[n]);
+  }
+  return n;
 }
 
-void maprequest(program_state *state, XEvent *e) {
-  static XWindowAttributes wa;
-  XMapRequestEvent *ev = &e->xmaprequest;
+/* moves the first n of tiled[] to the rectangles the layout chose */
+static void tiledresize(program_state *state, unsigned int n) {
+  unsigned int i;
+  Client *c;
+  LayoutRect *r;
 
-  if (!XGetWindowAttributes(state->dpy, ev->window, &wa) ||
-      wa.override_redirect)
-    return;
-  if (!wintoclient(ev->window))
-    manage(state, ev->window, &wa);
+  for (i = 0; i < n; i++) {
+    c = tiled[i];
+    r = &tiledr[i];
+    if (r->x != c->x || r->y != c->y || r->w != c->w || r->h != c->h)
+      resizeclient(state, c, r->x, r->y, r->w, r->h);
+  }
 }
 
 void monocle(program_state *state, Monitor *m) {
   unsigned int n = 0;
   Client *c;
+  LayoutRect area = {m->wx, m->wy, m->ww, m->wh};
 
   for (c = m->clients; c; c = c->next)
     if (ISVISIBLE(c))
       n++;
   if (n > 0) /* override layout symbol */
     snprintf(m->ltsymbol, sizeof m->ltsymbol, "[%d]", n);
-  for (c = nexttiled(m->clients); c; c = nexttiled(c->next))
-    resize(state, c, m->wx, m->wy, m->ww - 2 * c->bw, m->wh - 2 * c->bw, 0);
+  n = tiledclients(state, m);
+  layout_monocle(&area, bh, tiledlc, n, tiledr);
+  tiledresize(state, n);
 }
 
 void motionnotify(program_state *state, XEvent *e) {
@@ -965,6 +1679,46 @@ void motionnotify(program_state *state, XEvent *e) {
   mon = m;
 }
 
+/* sets pos to orig moved so that edge, measured from orig, lands on target,
+ * if that is the nearest so far */
+static void snapedge(int *dist, int *pos, int orig, int edge, int target) {
+  if (abs(target - edge) < *dist) {
+    *dist = abs(target - edge);
+    *pos = orig + target - edge;
+  }
+}
+
+/* Snaps the edges of c, about to move to nx, ny, to the edges of the
+ * monitor and of the visible windows next to it, whichever is nearest. */
+static void snapclient(Client *c, int *nx, int *ny) {
+  const GridItem **hit, *o;
+  int w = WIDTH(c), h = HEIGHT(c), x = *nx, y = *ny, dx = snap, dy = snap;
+  size_t i, n;
+
+  snapedge(&dx, nx, x, x, selmon->wx);
+  snapedge(&dx, nx, x, x + w, selmon->wx + selmon->ww);
+  snapedge(&dy, ny, y, y, selmon->wy);
+  snapedge(&dy, ny, y, y + h, selmon->wy + selmon->wh);
+  n = grid_query(clientgrid(), x - snap, y - snap, w + 2 * snap, h + 2 * snap,
+                 &hit);
+  for (i = 0; i < n; i++) {
+    if ((o = hit[i])->data == c)
+      continue;
+    if (o->y < y + h && y < o->y + o->h) { /* side by side */
+      snapedge(&dx, nx, x, x, o->x + o->w);
+      snapedge(&dx, nx, x, x + w, o->x);
+      snapedge(&dx, nx, x, x, o->x);
+      snapedge(&dx, nx, x, x + w, o->x + o->w);
+    }
+    if (o->x < x + w && x < o->x + o->w) { /* above each other */
+      snapedge(&dy, ny, y, y, o->y + o->h);
+      snapedge(&dy, ny, y, y + h, o->y);
+      snapedge(&dy, ny, y, y, o->y);
+      snapedge(&dy, ny, y, y + h, o->y + o->h);
+    }
+  }
+}
+
 void movemouse(program_state *state, const Arg *arg) {
   int x, y, ocx, ocy, nx, ny;
   Client *c;
@@ -985,6 +1739,9 @@ void movemouse(program_state *state, const Arg *arg) {
     return;
   if (!getrootptr(state, &x, &y))
     return;
+  /* snapclient() skips c, so its entry in wingrid may lag behind until the
+   * drag ends instead of rebuilding the grid on every step */
+  dragged = c;
   do {
     XMaskEvent(state->dpy, MOUSEMASK | ExposureMask | SubstructureRedirectMask,
                &ev);
@@ -1001,14 +1758,7 @@ void movemouse(program_state *state, const Arg *arg) {
 
       nx = ocx + (ev.xmotion.x - x);
       ny = ocy + (ev.xmotion.y - y);
-      if (abs(selmon->wx - nx) < snap)
-        nx = selmon->wx;
-      else if (abs((selmon->wx + selmon->ww) - (nx + WIDTH(c))) < snap)
-        nx = selmon->wx + selmon->ww - WIDTH(c);
-      if (abs(selmon->wy - ny) < snap)
-        ny = selmon->wy;
-      else if (abs((selmon->wy + selmon->wh) - (ny + HEIGHT(c))) < snap)
-        ny = selmon->wy + selmon->wh - HEIGHT(c);
+      snapclient(c, &nx, &ny);
       if (!c->isfloating && selmon->lt[selmon->sellt]->arrange &&
           (abs(nx - c->x) > snap || abs(ny - c->y) > snap))
         togglefloating(state, NULL);
@@ -1017,6 +1767,8 @@ void movemouse(program_state *state, const Arg *arg) {
       break;
     }
   } while (ev.type != ButtonRelease);
+  dragged = NULL;
+  wingridstale = 1;
   XUngrabPointer(state->dpy, CurrentTime);
   if ((m = recttomon(c->x, c->y, c->w, c->h)) != selmon) {
     sendmon(state, c, m);
@@ -1031,6 +1783,59 @@ Client *nexttiled(Client *c) {
   return c;
 }
 
+/* Starts cmd in a session of its own, where the C library can, and returns
+ * its pid, or 0. Unlike fork() this does not copy the page tables of dwm;
+ * the X connection and all other descriptors are close-on-exec. */
+static pid_t launch(const char *const *cmd) {
+  posix_spawnattr_t attr;
+  sigset_t set;
+  long long t = usec(), us;
+  pid_t pid;
+  int err;
+
+  /* signals the main loop reads from its signalfd are blocked */
+  sigemptyset(&set);
+  posix_spawnattr_init(&attr);
+  posix_spawnattr_setflags(&attr, SPAWNFLAGS);
+  posix_spawnattr_setsigmask(&attr, &set);
+  err = posix_spawnp(&pid, cmd[0], NULL, &attr, (char *const *)cmd, environ);
+  posix_spawnattr_destroy(&attr);
+  if (err) {
+    fprintf(stderr, "dwm: cannot run '%s': %s\n", cmd[0], strerror(err));
+    return 0;
+  }
+  us = usec() - t;
+  metrics.spawns++;
+  metrics.spawnlast = us;
+  metrics.spawnmax = MAX(metrics.spawnmax, us);
+  metrics.spawntotal += us;
+  return pid;
+}
+
+/* starts the missing instances of poolcmds[i] */
+void poolfill(program_state *state, unsigned int i) {
+  PoolEnt *e;
+
+  for (e = &pool[i * poolsize]; e < &pool[(i + 1) * poolsize]; e++)
+    if (!e->pid || (!e->win && kill(e->pid, 0) < 0)) {
+      e->win = 0;
+      e->pid = launch(poolcmds[i]);
+    }
+}
+
+/* Keeps the first window of a pool instance unmapped until spawn() adopts
+ * it. Returns 0 if pid is not a pool instance. */
+int poolwithhold(Window w, pid_t pid) {
+  unsigned int i;
+
+  for (i = 0; i < LENGTH(poolcmds) * poolsize; i++)
+    if (pool[i].win == w || (pool[i].pid == pid && !pool[i].win)) {
+      pool[i].win = w;
+      return 1;
+    }
+  return 0;
+}
+
 void pop(program_state *state, Client *c) {
   detach(c);
   attach(c);
@@ -1038,6 +1843,52 @@ void pop(program_state *state, Client *c) {
   arrange(state, c->mon);
 }
 
+static void refill(Throttle *t, long long now) {
+  t->tokens = MIN(propburst * 1000, t->tokens + (now - t->stamp) * proprate);
+  t->stamp = now;
+}
+
+static void throttleexpired(void *arg) {
+  Throttle *t = arg;
+
+  refill(t, loop_now());
+  t->tokens -= MIN(t->tokens, 1000);
+  propertyupdate(t->state, t->c, t->slot);
+}
+
+/* Token bucket per client and kind of update: propburst updates pass right
+ * away, after that proprate per second. Returns 1 if the update has to
+ * wait; it is then delivered once by a timer, so the last state always
+ * shows. */
+static int throttle(program_state *state, Client *c, int slot) {
+  long long now = loop_now();
+  Throttle *t;
+  int i;
+
+  if (!proprate)
+    return 0; /* unthrottled */
+  if (!c->throttle) {
+    c->throttle = ecalloc(ThrottleLast, sizeof(Throttle));
+    for (i = 0; i < ThrottleLast; i++) {
+      c->throttle[i].state = state;
+      c->throttle[i].c = c;
+      c->throttle[i].slot = i;
+      c->throttle[i].stamp = now;
+      c->throttle[i].tokens = propburst * 1000;
+    }
+  }
+  t = &c->throttle[slot];
+  if (t->timer.armed)
+    return 1; /* coalesced into the pending delivery */
+  refill(t, now);
+  if (t->tokens >= 1000) {
+    t->tokens -= 1000;
+    return 0;
+  }
+  timer_start(&t->timer, (1000 - t->tokens) / proprate + 1, throttleexpired, t);
+  return 1;
+}
+
 void propertynotify(program_state *state, XEvent *e) {
   Client *c;
   Window trans;
@@ -1061,31 +1912,51 @@ void propertynotify(program_state *state, XEvent *e) {
       c->hintsvalid = 0;
       break;
     case XA_WM_HINTS:
-      updatewmhints(state, c);
-      drawbars();
+      if (!throttle(state, c, ThrottleHints))
+        propertyupdate(state, c, ThrottleHints);
       break;
     }
-    if (ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) {
-      updatetitle(state, c);
-      if (c == c->mon->sel)
-        drawbar(c->mon);
-    }
+    if ((ev->atom == XA_WM_NAME || ev->atom == netatom[NetWMName]) &&
+        !throttle(state, c, ThrottleTitle))
+      propertyupdate(state, c, ThrottleTitle);
     if (ev->atom == netatom[NetWMWindowType])
       updatewindowtype(state, c);
   }
 }
 
+/* the work behind a throttled property change */
+void propertyupdate(program_state *state, Client *c, int slot) {
+  switch (slot) {
+  case ThrottleTitle:
+    updatetitle(state, c);
+    if (c == c->mon->sel)
+      invalidatebar(c->mon);
+    break;
+  case ThrottleHints:
+    updatewmhints(state, c);
+    invalidatebars();
+    break;
+  }
+}
+
 void quit(program_state *state, const Arg *arg) { running = 0; }
 
 Monitor *recttomon(int x, int y, int w, int h) {
+  const GridItem **hit;
   Monitor *m, *r = selmon;
   int a, area = 0;
-
-  for (m = mons; m; m = m->next)
-    if ((a = INTERSECT(x, y, w, h, m)) > area) {
+  size_t i, n;
+
+  n = grid_query(mongrid, x, y, w, h, &hit);
+  for (i = 0; i < n; i++) {
+    m = hit[i]->data;
+    /* ties go to the first monitor, as in mons */
+    if ((a = INTERSECT(x, y, w, h, m)) > area ||
+        (a && a == area && m->num < r->num)) {
       area = a;
       r = m;
     }
+  }
   return r;
 }
 
@@ -1107,6 +1978,11 @@ void resizeclient(program_state *state, Client *c, int x, int y, int w, int h) {
   c->oldh = c->h;
   c->h = wc.height = h;
   wc.border_width = c->bw;
+  /* a window hidden by moving it away stays there until showhide() */
+  if (c->ishidden && hidemode != HideUnmap)
+    wc.x = WIDTH(c) * -2;
+  if (c != dragged)
+    wingridstale = 1;
   XConfigureWindow(state->dpy, c->win,
                    CWX | CWY | CWWidth | CWHeight | CWBorderWidth, &wc);
   configure(state, c);
@@ -1179,7 +2055,11 @@ void restack(program_state *state, Monitor *m) {
   XEvent ev;
   XWindowChanges wc;
 
-  drawbar(m);
+  if (batching) {
+    m->dirty |= DirtyStack;
+    return;
+  }
+  invalidatebar(m);
   if (!m->sel)
     return;
   if (m->sel->isfloating || !m->lt[m->sellt]->arrange)
@@ -1198,21 +2078,289 @@ void restack(program_state *state, Monitor *m) {
     ;
 }
 
+void restart(program_state *state, const Arg *arg) {
+  restarting = 1;
+  running = 0;
+}
+
+void restoreclient(Client *c, const SavedClient *sc) {
+  Monitor *m;
+
+  for (m = mons; m && m->num != sc->mon; m = m->next)
+    ;
+  c->mon = m ? m : selmon;
+  c->tags = sc->tags & TAGMASK ? sc->tags & TAGMASK
+                               : c->mon->tagset[c->mon->seltags];
+  c->x = sc->x;
+  c->y = sc->y;
+  c->w = sc->w;
+  c->h = sc->h;
+  c->oldx = sc->oldx;
+  c->oldy = sc->oldy;
+  c->oldw = sc->oldw;
+  c->oldh = sc->oldh;
+}
+
+/* picks up the state left by the process that restarted into us, see
+ * savestate(); the client records are kept for manage() */
+void restoremonitors(program_state *state) {
+  SavedState hdr;
+  SavedMonitor sm;
+  Monitor *m;
+  FILE *f;
+  char *env;
+  unsigned int i, j;
+  int fd;
+
+  if (!(env = getenv("DWM_RESTART_FD")))
+    return;
+  fd = atoi(env);
+  unsetenv("DWM_RESTART_FD");
+  if (fd <= STDERR_FILENO || !(f = fdopen(fd, "r")))
+    return;
+  rewind(f);
+  if (fread(&hdr, sizeof hdr, 1, f) != 1 || hdr.version != STATEVERSION)
+    goto out;
+  for (i = 0; i < hdr.nmons && fread(&sm, sizeof sm, 1, f) == 1; i++) {
+    for (m = mons; m && m->num != sm.num; m = m->next)
+      ;
+    if (!m)
+      continue;
+    m->seltags = sm.seltags & 1;
+    m->sellt = sm.sellt & 1;
+    for (j = 0; j < 2; j++) {
+      if (sm.tagset[j] & TAGMASK)
+        m->tagset[j] = sm.tagset[j] & TAGMASK;
+      if (sm.lt[j] < LENGTH(layouts))
+        m->lt[j] = &layouts[sm.lt[j]];
+    }
+    m->mfact = sm.mfact;
+    m->nmaster = sm.nmaster;
+    strncpy(m->ltsymbol, m->lt[m->sellt]->symbol, sizeof m->ltsymbol);
+    if (m->showbar != sm.showbar) {
+      m->showbar = sm.showbar;
+      updatebarpos(m);
+      XMoveResizeWindow(state->dpy, m->barwin, m->wx, m->by, m->ww, bh);
+    }
+    if (m->num == hdr.selmon)
+      selmon = m;
+  }
+  if (i == hdr.nmons && hdr.nclients) {
+    saved = ecalloc(hdr.nclients, sizeof(SavedClient));
+    nsaved = fread(saved, sizeof(SavedClient), hdr.nclients, f);
+  }
+out:
+  fclose(f);
+}
+
+/* puts restored clients back into their saved tiling and focus order */
+static void restoreorder(program_state *state) {
+  Client *c;
+  Monitor *m;
+  int i, pos, maxpos = 0;
+
+  /* attach() and attachstack() prepend, so go from the back */
+  for (i = nsaved - 1; i >= 0; i--) {
+    if ((c = wintoclient(saved[i].win))) {
+      detach(c);
+      attach(c);
+    }
+    maxpos = MAX(maxpos, saved[i].stackpos);
+  }
+  for (pos = maxpos; pos >= 0; pos--)
+    for (i = 0; i < nsaved; i++)
+      if (saved[i].stackpos == pos && (c = wintoclient(saved[i].win))) {
+        detachstack(c);
+        attachstack(c);
+      }
+  for (m = mons; m; m = m->next) {
+    for (c = m->stack; c && !ISVISIBLE(c); c = c->snext)
+      ;
+    m->sel = c;
+  }
+  focus(state, NULL);
+}
+
 void run(program_state *state) {
   XEvent ev;
+
   /* main event loop */
   XSync(state->dpy, False);
-  while (running && !XNextEvent(state->dpy, &ev))
-    if (handler[ev.type])
-      handler[ev.type](state, &ev); /* call handler */
+  while (running) {
+    /* XPending() also flushes what timers and the socket queued */
+    while (running && XPending(state->dpy)) {
+      XNextEvent(state->dpy, &ev);
+      if (handler[ev.type])
+        handler[ev.type](state, &ev); /* call handler */
+    }
+    updatefsmode(state);
+    flushbars();
+    /* once per batch; both do nothing when nothing changed */
+    updatedesktops(state);
+    updatesnapshot();
+    /* drawing syncs with the server and may have queued new events */
+    if (running && !XPending(state->dpy))
+      loop_wait();
+  }
+}
+
+#ifdef XCB
+/* scan() with the attribute, geometry, WM_STATE and WM_TRANSIENT_FOR requests
+ * of all top-level windows in flight at once */
+static void scanbatched(program_state *state, Window *wins, unsigned int num) {
+  xcb_connection_t *xc = XGetXCBConnection(state->dpy);
+  struct {
+    xcb_get_window_attributes_cookie_t attr;
+    xcb_get_geometry_cookie_t geom;
+    xcb_get_property_cookie_t wmstate, trans;
+  } *ck;
+  struct {
+    XWindowAttributes wa;
+    int ok, istrans;
+    long wmstate;
+  } *info;
+  xcb_get_window_attributes_reply_t *ar;
+  xcb_get_geometry_reply_t *gr;
+  xcb_get_property_reply_t *sr, *tr;
+  xcb_generic_error_t *err[4];
+  unsigned int i;
+  uint32_t v;
+
+  ck = ecalloc(num, sizeof *ck);
+  info = ecalloc(num, sizeof *info);
+  for (i = 0; i < num; i++) {
+    ck[i].attr = xcb_get_window_attributes(xc, wins[i]);
+    ck[i].geom = xcb_get_geometry(xc, wins[i]);
+    ck[i].wmstate = xcb_get_property(xc, 0, wins[i], wmatom[WMState],
+                                     wmatom[WMState], 0, 2);
+    ck[i].trans = xcb_get_property(xc, 0, wins[i], XA_WM_TRANSIENT_FOR,
+                                   XA_WINDOW, 0, 1);
+  }
+  for (i = 0; i < num; i++) {
+    memset(err, 0, sizeof err);
+    ar = xcb_get_window_attributes_reply(xc, ck[i].attr, &err[0]);
+    gr = xcb_get_geometry_reply(xc, ck[i].geom, &err[1]);
+    sr = xcb_get_property_reply(xc, ck[i].wmstate, &err[2]);
+    tr = xcb_get_property_reply(xc, ck[i].trans, &err[3]);
+    if ((info[i].ok = ar && gr)) {
+      info[i].wa.x = gr->x;
+      info[i].wa.y = gr->y;
+      info[i].wa.width = gr->width;
+      info[i].wa.height = gr->height;
+      info[i].wa.border_width = gr->border_width;
+      info[i].wa.override_redirect = ar->override_redirect;
+      info[i].wa.map_state = ar->map_state;
+    }
+    info[i].wmstate = propcard32(sr, wmatom[WMState], &v) ? (long)v : -1;
+    info[i].istrans = propcard32(tr, XA_WINDOW, &v);
+    free(ar);
+    free(gr);
+    free(sr);
+    free(tr);
+    free(err[0]);
+    free(err[1]);
+    free(err[2]);
+    free(err[3]);
+  }
+  for (i = 0; i < num; i++) {
+    if (!info[i].ok || info[i].wa.override_redirect || info[i].istrans)
+      continue;
+    if (info[i].wa.map_state == IsViewable || info[i].wmstate == IconicState)
+      manage(state, wins[i], &info[i].wa);
+  }
+  for (i = 0; i < num; i++) /* now the transients */
+    if (info[i].ok && info[i].istrans &&
+        (info[i].wa.map_state == IsViewable || info[i].wmstate == IconicState))
+      manage(state, wins[i], &info[i].wa);
+  free(ck);
+  free(info);
+}
+#endif /* XCB */
+
+/* Writes monitor and client state to an unlinked file whose descriptor
+ * reexec() hands to the next process. */
+void savestate(program_state *state) {
+  SavedState hdr = {STATEVERSION, 0, 0, selmon->num};
+  SavedMonitor sm;
+  SavedClient sc;
+  Monitor *m;
+  Client *c, *s;
+  FILE *f;
+  char fd[16];
+  int i;
+
+  if (!(f = tmpfile())) {
+    fputs("dwm: cannot save state, restarting without it\n", stderr);
+    return;
+  }
+  for (m = mons; m; m = m->next, hdr.nmons++)
+    for (c = m->clients; c; c = c->next)
+      hdr.nclients++;
+  fwrite(&hdr, sizeof hdr, 1, f);
+  for (m = mons; m; m = m->next) {
+    memset(&sm, 0, sizeof sm);
+    sm.num = m->num;
+    sm.seltags = m->seltags;
+    sm.sellt = m->sellt;
+    for (i = 0; i < 2; i++) {
+      sm.tagset[i] = m->tagset[i];
+      sm.lt[i] = m->lt[i] - layouts;
+    }
+    sm.mfact = m->mfact;
+    sm.nmaster = m->nmaster;
+    sm.showbar = m->showbar;
+    fwrite(&sm, sizeof sm, 1, f);
+  }
+  for (m = mons; m; m = m->next)
+    for (c = m->clients; c; c = c->next) {
+      memset(&sc, 0, sizeof sc);
+      sc.win = c->win;
+      sc.tags = c->tags;
+      sc.mon = m->num;
+      sc.x = c->x;
+      sc.y = c->y;
+      sc.w = c->w;
+      sc.h = c->h;
+      sc.oldx = c->oldx;
+      sc.oldy = c->oldy;
+      sc.oldw = c->oldw;
+      sc.oldh = c->oldh;
+      sc.oldbw = c->oldbw;
+      for (i = 0, s = m->stack; s && s != c; s = s->snext)
+        i++;
+      sc.stackpos = i;
+      sc.isfloating = c->isfloating;
+      sc.isfullscreen = c->isfullscreen;
+      sc.oldstate = c->oldstate;
+      fwrite(&sc, sizeof sc, 1, f);
+    }
+  if (fflush(f) || ferror(f)) {
+    fputs("dwm: cannot save state, restarting without it\n", stderr);
+    fclose(f);
+    return;
+  }
+  /* f stays open, its descriptor has to survive until exec */
+  snprintf(fd, sizeof fd, "%d", fileno(f));
+  setenv("DWM_RESTART_FD", fd, 1);
 }
 
 void scan(program_state *state) {
-  unsigned int i, num;
+  unsigned int num;
   Window d1, d2, *wins = NULL;
+#ifndef XCB
+  unsigned int i;
   XWindowAttributes wa;
+#endif /* XCB */
 
+  /* after a restart everything is adopted in one batch */
+  restoremonitors(state);
+  if (saved)
+    batching++;
   if (XQueryTree(state->dpy, root, &d1, &d2, &wins, &num)) {
+    alloc_count(wins, "XQueryTree");
+#ifdef XCB
+    scanbatched(state, wins, num);
+#else
     for (i = 0; i < num; i++) {
       if (!XGetWindowAttributes(state->dpy, wins[i], &wa) ||
           wa.override_redirect ||
@@ -1229,8 +2377,17 @@ void scan(program_state *state) {
            getstate(state, wins[i]) == IconicState))
         manage(state, wins[i], &wa);
     }
+#endif /* XCB */
     if (wins)
-      XFree(wins);
+      xfree(wins);
+  }
+  if (saved) {
+    restoreorder(state);
+    free(saved);
+    saved = NULL;
+    nsaved = 0;
+    if (!--batching)
+      arrangedirty(state);
   }
 }
 
@@ -1240,12 +2397,14 @@ void sendmon(program_state *state, Client *c, Monitor *m) {
   unfocus(state, c, 1);
   detach(c);
   detachstack(c);
+  c->mon->dirty |= DirtyLayout | DirtyVisibility;
   c->mon = m;
   c->tags = m->tagset[m->seltags]; /* assign tags of target monitor */
   attach(c);
   attachstack(c);
+  m->dirty |= DirtyLayout | DirtyVisibility;
   focus(state, NULL);
-  arrange(state, NULL);
+  arrangedirty(state);
 }
 
 void setclientstate(program_state *state, Client *c, long i_state) {
@@ -1262,9 +2421,10 @@ int sendevent(program_state *state, Client *c, Atom proto) {
   XEvent ev;
 
   if (XGetWMProtocols(state->dpy, c->win, &protocols, &n)) {
+    alloc_count(protocols, "XGetWMProtocols");
     while (!exists && n--)
       exists = protocols[n] == proto;
-    XFree(protocols);
+    xfree(protocols);
   }
   if (exists) {
     ev.type = ClientMessage;
@@ -1289,10 +2449,8 @@ void setfocus(program_state *state, Client *c) {
 
 void setfullscreen(program_state *state, Client *c, int fullscreen) {
   if (fullscreen && !c->isfullscreen) {
-    XChangeProperty(state->dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-                    PropModeReplace, (unsigned char *)&netatom[NetWMFullscreen],
-                    1);
     c->isfullscreen = 1;
+    setnetwmstate(state, c);
     c->oldstate = c->isfloating;
     c->oldbw = c->bw;
     c->bw = 0;
@@ -1300,9 +2458,8 @@ void setfullscreen(program_state *state, Client *c, int fullscreen) {
     resizeclient(state, c, c->mon->mx, c->mon->my, c->mon->mw, c->mon->mh);
     XRaiseWindow(state->dpy, c->win);
   } else if (!fullscreen && c->isfullscreen) {
-    XChangeProperty(state->dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
-                    PropModeReplace, (unsigned char *)0, 0);
     c->isfullscreen = 0;
+    setnetwmstate(state, c);
     c->isfloating = c->oldstate;
     c->bw = c->oldbw;
     c->x = c->oldx;
@@ -1314,6 +2471,25 @@ void setfullscreen(program_state *state, Client *c, int fullscreen) {
   }
 }
 
+/* Hides or shows c the way hidemode asks for. Anything but HideMove also
+ * tells the client through WM_STATE and _NET_WM_STATE_HIDDEN, so it can
+ * stop rendering. */
+void sethidden(program_state *state, Client *c, int hidden) {
+  c->ishidden = hidden;
+  if (hidemode == HideUnmap) {
+    if (hidden) {
+      c->ignoreunmap++;
+      XUnmapWindow(state->dpy, c->win);
+    } else
+      XMapWindow(state->dpy, c->win);
+  } else if (hidden)
+    XMoveWindow(state->dpy, c->win, WIDTH(c) * -2, c->y);
+  if (hidemode != HideMove) {
+    setclientstate(state, c, hidden ? IconicState : NormalState);
+    setnetwmstate(state, c);
+  }
+}
+
 void setlayout(program_state *state, const Arg *arg) {
   if (!arg || !arg->v || arg->v != selmon->lt[selmon->sellt])
     selmon->sellt ^= 1;
@@ -1324,7 +2500,7 @@ void setlayout(program_state *state, const Arg *arg) {
   if (selmon->sel)
     arrange(state, selmon);
   else
-    drawbar(selmon);
+    invalidatebar(selmon);
 }
 
 /* arg > 1.0 will set mfact absolutely */
@@ -1340,18 +2516,111 @@ void setmfact(program_state *state, const Arg *arg) {
   arrange(state, selmon);
 }
 
+/* _NET_WM_STATE as far as dwm manages it */
+void setnetwmstate(program_state *state, Client *c) {
+  Atom atoms[2];
+  int n = 0;
+
+  if (c->isfullscreen)
+    atoms[n++] = netatom[NetWMFullscreen];
+  if (c->ishidden && hidemode != HideMove)
+    atoms[n++] = netatom[NetWMHidden];
+  XChangeProperty(state->dpy, c->win, netatom[NetWMState], XA_ATOM, 32,
+                  PropModeReplace, (unsigned char *)atoms, n);
+}
+
+/* switches to palettes[arg->i], or to the next one if arg->i < 0 */
+void setpalette(program_state *state, const Arg *arg) {
+  unsigned int p = arg->i < 0 ? (curpalette + 1) % LENGTH(palettes) : arg->i;
+  Monitor *m;
+  Client *c;
+
+  if (p >= LENGTH(palettes) || p == curpalette)
+    return;
+  curpalette = p;
+  scheme = palette[p];
+  for (m = mons; m; m = m->next)
+    for (c = m->clients; c; c = c->next)
+      XSetWindowBorder(
+          state->dpy, c->win,
+          scheme[c == selmon->sel ? SchemeSel : SchemeNorm][ColBorder].pixel);
+  invalidatebars();
+}
+
+void setsizehints(Client *c, XSizeHints *size) {
+  if (size->flags & PBaseSize) {
+    c->basew = size->base_width;
+    c->baseh = size->base_height;
+  } else if (size->flags & PMinSize) {
+    c->basew = size->min_width;
+    c->baseh = size->min_height;
+  } else
+    c->basew = c->baseh = 0;
+  if (size->flags & PResizeInc) {
+    c->incw = size->width_inc;
+    c->inch = size->height_inc;
+  } else
+    c->incw = c->inch = 0;
+  if (size->flags & PMaxSize) {
+    c->maxw = size->max_width;
+    c->maxh = size->max_height;
+  } else
+    c->maxw = c->maxh = 0;
+  if (size->flags & PMinSize) {
+    c->minw = size->min_width;
+    c->minh = size->min_height;
+  } else if (size->flags & PBaseSize) {
+    c->minw = size->base_width;
+    c->minh = size->base_height;
+  } else
+    c->minw = c->minh = 0;
+  if (size->flags & PAspect) {
+    c->mina = (float)size->min_aspect.y / size->min_aspect.x;
+    c->maxa = (float)size->max_aspect.x / size->max_aspect.y;
+  } else
+    c->maxa = c->mina = 0.0;
+  c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
+  c->haspos = !!(size->flags & (USPosition | PPosition));
+  c->hintsvalid = 1;
+}
+
+#ifdef ALLOCSTATS
+static void allocdump(int sig, void *arg) { alloc_dump(); }
+#endif
+
+static void statusready(int fd, void *arg) {
+  if (status_read(stext, sizeof stext))
+    invalidatebar(selmon);
+}
+
+/* the user and display, to keep the names of instances apart */
+static void instancename(program_state *state, char *buf, size_t size) {
+  char *p;
+
+  snprintf(buf, size, "%u-%s", (unsigned int)getuid(),
+           DisplayString(state->dpy));
+  for (p = buf; *p; p++)
+    if (*p == '/')
+      *p = '_';
+}
+
 void setup(program_state *state) {
 
-  int i;
+  int i, j, k;
+  long n;
   XSetWindowAttributes wa;
   Atom utf8string;
-  struct sigaction sa;
-
-  /* do not transform children into zombies when they terminate */
-  sigemptyset(&sa.sa_mask);
-  sa.sa_flags = SA_NOCLDSTOP | SA_NOCLDWAIT | SA_RESTART;
-  sa.sa_handler = SIG_IGN;
-  sigaction(SIGCHLD, &sa, NULL);
+  char path[256] = "", inst[128];
+
+  /* the main loop waits on the X connection, timers and signals at once;
+   * children are reaped from there as they terminate */
+  loop_init();
+  fcntl(ConnectionNumber(state->dpy), F_SETFD, FD_CLOEXEC);
+  loop_watch(ConnectionNumber(state->dpy), NULL, NULL);
+  loop_signal(SIGCHLD, sigchld, state);
+#ifdef ALLOCSTATS
+  loop_signal(SIGUSR1, allocdump, NULL);
+#endif
 
   /* clean up any zombies (inherited from .xinitrc etc) immediately */
   while (waitpid(-1, NULL, WNOHANG) > 0)
@@ -1363,10 +2632,26 @@ void setup(program_state *state) {
   sh = DisplayHeight(state->dpy, screen);
   root = RootWindow(state->dpy, screen);
   drw = drw_create(state->dpy, screen, root, sw, sh);
+  if (getenv("XDG_CACHE_HOME"))
+    snprintf(path, sizeof path, "%s", getenv("XDG_CACHE_HOME"));
+  else if (getenv("HOME"))
+    snprintf(path, sizeof path, "%s/.cache", getenv("HOME"));
+  if (path[0]) {
+    mkdir(path, 0755);
+    snprintf(fontcache, sizeof fontcache, "%s/dwm", path);
+    mkdir(fontcache, 0755);
+    snprintf(fontcache, sizeof fontcache, "%s/dwm/fonts", path);
+  }
+  drw_fontcache_load(drw, fontcache);
   if (!drw_fontset_create(drw, fonts, LENGTH(fonts)))
     die("no fonts could be loaded.");
   lrpad = drw->fonts->h;
   bh = drw->fonts->h + 2;
+  if ((i = drw_fallback_start(drw)) >= 0)
+    loop_watch(i, fontready, state);
+  if (builtinstatus && (statusfd = status_start(statusmods, LENGTH(statusmods),
+                                                statussep)) >= 0)
+    loop_watch(statusfd, statusready, state);
   updategeom(state);
   /* init atoms */
   utf8string = XInternAtom(state->dpy, "UTF8_STRING", False);
@@ -1374,6 +2659,7 @@ void setup(program_state *state) {
   wmatom[WMDelete] = XInternAtom(state->dpy, "WM_DELETE_WINDOW", False);
   wmatom[WMState] = XInternAtom(state->dpy, "WM_STATE", False);
   wmatom[WMTakeFocus] = XInternAtom(state->dpy, "WM_TAKE_FOCUS", False);
+  wmatom[WMTags] = XInternAtom(state->dpy, "_DWM_TAGS", False);
   netatom[NetActiveWindow] =
       XInternAtom(state->dpy, "_NET_ACTIVE_WINDOW", False);
   netatom[NetSupported] = XInternAtom(state->dpy, "_NET_SUPPORTED", False);
@@ -1383,19 +2669,36 @@ void setup(program_state *state) {
       XInternAtom(state->dpy, "_NET_SUPPORTING_WM_CHECK", False);
   netatom[NetWMFullscreen] =
       XInternAtom(state->dpy, "_NET_WM_STATE_FULLSCREEN", False);
+  netatom[NetWMHidden] = XInternAtom(state->dpy, "_NET_WM_STATE_HIDDEN", False);
+  netatom[NetWMPid] = XInternAtom(state->dpy, "_NET_WM_PID", False);
   netatom[NetWMWindowType] =
       XInternAtom(state->dpy, "_NET_WM_WINDOW_TYPE", False);
   netatom[NetWMWindowTypeDialog] =
       XInternAtom(state->dpy, "_NET_WM_WINDOW_TYPE_DIALOG", False);
   netatom[NetClientList] = XInternAtom(state->dpy, "_NET_CLIENT_LIST", False);
+  netatom[NetNumberOfDesktops] =
+      XInternAtom(state->dpy, "_NET_NUMBER_OF_DESKTOPS", False);
+  netatom[NetCurrentDesktop] =
+      XInternAtom(state->dpy, "_NET_CURRENT_DESKTOP", False);
+  netatom[NetDesktopNames] = XInternAtom(state->dpy, "_NET_DESKTOP_NAMES", False);
+  netatom[NetWMDesktop] = XInternAtom(state->dpy, "_NET_WM_DESKTOP", False);
   /* init cursors */
   cursor[CurNormal] = drw_cur_create(drw, XC_left_ptr);
   cursor[CurResize] = drw_cur_create(drw, XC_sizing);
   cursor[CurMove] = drw_cur_create(drw, XC_fleur);
   /* init appearance */
-  scheme = ecalloc(LENGTH(colors), sizeof(Clr *));
-  for (i = 0; i < LENGTH(colors); i++)
-    scheme[i] = drw_scm_create(drw, colors[i], 3);
+  palette = ecalloc(LENGTH(palettes), sizeof(Clr **));
+  for (j = 0; j < LENGTH(palettes); j++) {
+    palette[j] = ecalloc(LENGTH(colors), sizeof(Clr *));
+    for (i = 0; i < LENGTH(colors); i++) {
+      /* a table with too few schemes is filled up with NULL */
+      for (k = 0; k < 3; k++)
+        if (!palettes[j][i][k])
+          die("dwm: palettes[%d] lacks colors for scheme %d", j, i);
+      palette[j][i] = drw_scm_create(drw, palettes[j][i], 3);
+    }
+  }
+  scheme = palette[curpalette];
   /* init bars */
   updatebars(state);
   updatestatus(state);
@@ -1411,15 +2714,44 @@ void setup(program_state *state) {
   XChangeProperty(state->dpy, root, netatom[NetSupported], XA_ATOM, 32,
                   PropModeReplace, (unsigned char *)netatom, NetLast);
   XDeleteProperty(state->dpy, root, netatom[NetClientList]);
+  /* one desktop per tag */
+  n = LENGTH(tags);
+  XChangeProperty(state->dpy, root, netatom[NetNumberOfDesktops], XA_CARDINAL,
+                  32, PropModeReplace, (unsigned char *)&n, 1);
+  for (i = 0, j = 0; i < LENGTH(tags) && j < sizeof path; i++)
+    j += snprintf(path + j, sizeof path - j, "%s", tags[i]) + 1;
+  XChangeProperty(state->dpy, root, netatom[NetDesktopNames], utf8string, 8,
+                  PropModeReplace, (unsigned char *)path,
+                  MIN(j, (int)sizeof path));
   /* select events */
   wa.cursor = cursor[CurNormal]->cursor;
-  wa.event_mask = SubstructureRedirectMask | SubstructureNotifyMask |
-                  ButtonPressMask | PointerMotionMask | EnterWindowMask |
-                  LeaveWindowMask | StructureNotifyMask | PropertyChangeMask;
-  XChangeWindowAttributes(state->dpy, root, CWEventMask | CWCursor, &wa);
-  XSelectInput(state->dpy, root, wa.event_mask);
+  XChangeWindowAttributes(state->dpy, root, CWCursor, &wa);
+  updaterootmask(state);
   grabkeys(state);
+  if (shmname[0]) {
+    instancename(state, inst, sizeof inst);
+    snprintf(path, sizeof path, "%s-%s", shmname, inst);
+    shm = shm_create(path);
+  }
+  if (poolsize) {
+    pool = ecalloc(LENGTH(poolcmds) * poolsize, sizeof(PoolEnt));
+    for (i = 0; i < LENGTH(poolcmds); i++)
+      poolfill(state, i);
+  }
   focus(state, NULL);
+  /* command socket */
+  if (ipcsocket[0] == '/')
+    ipc = ipc_create(ipcsocket, ipccommand, state);
+  else if (ipcsocket[0]) {
+    /* /tmp is shared by all users and displays */
+    instancename(state, inst, sizeof inst);
+    if (getenv("XDG_RUNTIME_DIR"))
+      snprintf(path, sizeof path, "%s/%s", getenv("XDG_RUNTIME_DIR"),
+               ipcsocket);
+    else
+      snprintf(path, sizeof path, "/tmp/%s-%s", ipcsocket, inst);
+    ipc = ipc_create(path, ipccommand, state);
+  }
 }
 
 void seturgent(program_state *state, Client *c, int urg) {
@@ -1428,9 +2760,30 @@ void seturgent(program_state *state, Client *c, int urg) {
   c->isurgent = urg;
   if (!(wmh = XGetWMHints(state->dpy, c->win)))
     return;
+  alloc_count(wmh, "XGetWMHints");
   wmh->flags = urg ? (wmh->flags | XUrgencyHint) : (wmh->flags & ~XUrgencyHint);
   XSetWMHints(state->dpy, c->win, wmh);
-  XFree(wmh);
+  xfree(wmh);
+}
+
+void setwindowtype(program_state *state, Client *c, Atom wstate,
+                   Atom wtype) {
+  if (wstate == netatom[NetWMFullscreen])
+    setfullscreen(state, c, 1);
+  if (wtype == netatom[NetWMWindowTypeDialog])
+    c->isfloating = 1;
+}
+
+void setwmhints(program_state *state, Client *c, XWMHints *wmh) {
+  if (c == selmon->sel && wmh->flags & XUrgencyHint) {
+    wmh->flags &= ~XUrgencyHint;
+    XSetWMHints(state->dpy, c->win, wmh);
+  } else
+    c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
+  if (wmh->flags & InputHint)
+    c->neverfocus = !wmh->input;
+  else
+    c->neverfocus = 0;
 }
 
 void showhide(program_state *state, Client *c) {
@@ -1439,35 +2792,57 @@ void showhide(program_state *state, Client *c) {
   if (ISVISIBLE(c)) {
     /* show clients top down */
     XMoveWindow(state->dpy, c->win, c->x, c->y);
+    if (c->ishidden)
+      sethidden(state, c, 0);
     if ((!c->mon->lt[c->mon->sellt]->arrange || c->isfloating) &&
         !c->isfullscreen)
       resize(state, c, c->x, c->y, c->w, c->h, 0);
     showhide(state, c->snext);
   } else {
-    /* hide clients bottom up */
+    /* hide clients bottom up, already hidden ones cost nothing */
     showhide(state, c->snext);
-    XMoveWindow(state->dpy, c->win, WIDTH(c) * -2, c->y);
+    if (!c->ishidden)
+      sethidden(state, c, 1);
   }
 }
 
+void sigchld(int sig, void *arg) {
+  while (waitpid(-1, NULL, WNOHANG) > 0)
+    ;
+}
+
+/* Runs a pooled command by adopting one of its waiting instances, if
+ * any, and starts a replacement. */
 void spawn(program_state *state, const Arg *arg) {
-  struct sigaction sa;
+  static unsigned int next;
+  XWindowAttributes wa;
+  long long t = usec();
+  unsigned int i, j;
+  Window w;
 
   if (arg->v == dmenucmd)
     dmenumon[0] = '0' + selmon->num;
-  if (fork() == 0) {
-    if (state->dpy)
-      close(ConnectionNumber(state->dpy));
-    setsid();
-
-    sigemptyset(&sa.sa_mask);
-    sa.sa_flags = 0;
-    sa.sa_handler = SIG_DFL;
-    sigaction(SIGCHLD, &sa, NULL);
-
-    execvp(((char **)arg->v)[0], (char **)arg->v);
-    die("dwm: execvp '%s' failed:", ((char **)arg->v)[0]);
+  for (i = 0; poolsize && i < LENGTH(poolcmds) && poolcmds[i] != arg->v; i++)
+    ;
+  if (!poolsize || i == LENGTH(poolcmds)) {
+    launch(arg->v);
+    return;
+  }
+  for (j = i * poolsize; j < (i + 1) * poolsize && !pool[j].win; j++)
+    ;
+  if (j < (i + 1) * poolsize &&
+      XGetWindowAttributes(state->dpy, pool[j].win, &wa)) {
+    w = pool[j].win;
+    pool[j].pid = pool[j].win = 0;
+    metrics.poolhits++;
+    manage(state, w, &wa);
+    mapped(t);
+  } else {
+    launches[next].pid = launch(arg->v);
+    launches[next].t = t;
+    next = (next + 1) % LENGTH(launches);
   }
+  poolfill(state, i);
 }
 
 void tag(program_state *state, const Arg *arg) {
@@ -1485,32 +2860,11 @@ void tagmon(program_state *state, const Arg *arg) {
 }
 
 void tile(program_state *state, Monitor *m) {
-  unsigned int i, n, h, mw, my, ty;
-  Client *c;
-
-  for (n = 0, c = nexttiled(m->clients); c; c = nexttiled(c->next), n++)
-    ;
-  if (n == 0)
-    return;
+  unsigned int n = tiledclients(state, m);
+  LayoutRect area = {m->wx, m->wy, m->ww, m->wh};
 
-  if (n > m->nmaster)
-    mw = m->nmaster ? m->ww * m->mfact : 0;
-  else
-    mw = m->ww;
-  for (i = my = ty = 0, c = nexttiled(m->clients); c;
-       c = nexttiled(c->next), i++)
-    if (i < m->nmaster) {
-      h = (m->wh - my) / (MIN(n, m->nmaster) - i);
-      resize(state, c, m->wx, m->wy + my, mw - (2 * c->bw), h - (2 * c->bw), 0);
-      if (my + HEIGHT(c) < m->wh)
-        my += HEIGHT(c);
-    } else {
-      h = (m->wh - ty) / (n - i);
-      resize(state, c, m->wx + mw, m->wy + ty, m->ww - mw - (2 * c->bw),
-             h - (2 * c->bw), 0);
-      if (ty + HEIGHT(c) < m->wh)
-        ty += HEIGHT(c);
-    }
+  layout_tile(&area, m->mfact, m->nmaster, bh, tiledlc, n, tiledr);
+  tiledresize(state, n);
 }
 
 void togglebar(program_state *state, const Arg *arg) {
@@ -1571,6 +2925,7 @@ void unfocus(program_state *state, Client *c, int setfocus) {
 void unmanage(program_state *state, Client *c, int destroyed) {
   Monitor *m = c->mon;
   XWindowChanges wc;
+  int i;
 
   detach(c);
   detachstack(c);
@@ -1582,11 +2937,18 @@ void unmanage(program_state *state, Client *c, int destroyed) {
     XConfigureWindow(state->dpy, c->win, CWBorderWidth,
                      &wc); /* restore border */
     XUngrabButton(state->dpy, AnyButton, AnyModifier, c->win);
+    XDeleteProperty(state->dpy, c->win, netatom[NetWMDesktop]);
+    XDeleteProperty(state->dpy, c->win, wmatom[WMTags]);
     setclientstate(state, c, WithdrawnState);
     XSync(state->dpy, False);
     XSetErrorHandler(xerror);
     XUngrabServer(state->dpy);
   }
+  if (c->throttle) {
+    for (i = 0; i < ThrottleLast; i++)
+      timer_stop(&c->throttle[i].timer);
+    free(c->throttle);
+  }
   free(c);
   focus(state, NULL);
   updateclientlist(state);
@@ -1600,6 +2962,10 @@ void unmapnotify(program_state *state, XEvent *e) {
   if ((c = wintoclient(ev->window))) {
     if (ev->send_event)
       setclientstate(state, c, WithdrawnState);
+    else if (ev->event != ev->window)
+      ; /* the root's copy, the client's own StructureNotify follows */
+    else if (c->ignoreunmap)
+      c->ignoreunmap--; /* hidden by sethidden() */
     else
       unmanage(state, c, 0);
   }
@@ -1624,6 +2990,7 @@ void updatebars(program_state *state) {
     XDefineCursor(state->dpy, m->barwin, cursor[CurNormal]->cursor);
     XMapRaised(state->dpy, m->barwin);
     XSetClassHint(state->dpy, m->barwin, &ch);
+    m->dirty &= ~DirtyBarPos; /* created in place */
   }
 }
 
@@ -1649,8 +3016,61 @@ void updateclientlist(program_state *state) {
                       PropModeAppend, (unsigned char *)&(c->win), 1);
 }
 
+/* the desktop of a tag mask: its first tag, 0xFFFFFFFF for all of them */
+static long tagdesktop(unsigned int mask) {
+  long i;
+
+  if ((mask & TAGMASK) == TAGMASK)
+    return 0xFFFFFFFF;
+  for (i = 0; i < (long)LENGTH(tags) - 1 && !(mask & 1 << i); i++)
+    ;
+  return i;
+}
+
+/* Publishes the tags as EWMH desktops, once per event batch and only what
+ * changed since, so pagers need not poll. */
+void updatedesktops(program_state *state) {
+  static long cur = -1;
+  unsigned int mask = selmon->tagset[selmon->seltags];
+  Monitor *m;
+  Client *c;
+  long d;
+
+  /* pagers know no "all desktops" for the view, it shows the first tag */
+  if ((d = (mask & TAGMASK) == TAGMASK ? 0 : tagdesktop(mask)) != cur) {
+    cur = d;
+    XChangeProperty(state->dpy, root, netatom[NetCurrentDesktop], XA_CARDINAL,
+                    32, PropModeReplace, (unsigned char *)&d, 1);
+  }
+  for (m = mons; m; m = m->next)
+    for (c = m->clients; c; c = c->next) {
+      if (c->tags == c->pubtags)
+        continue;
+      c->pubtags = c->tags;
+      d = tagdesktop(c->tags);
+      XChangeProperty(state->dpy, c->win, netatom[NetWMDesktop], XA_CARDINAL,
+                      32, PropModeReplace, (unsigned char *)&d, 1);
+      d = c->tags;
+      XChangeProperty(state->dpy, c->win, wmatom[WMTags], XA_CARDINAL, 32,
+                      PropModeReplace, (unsigned char *)&d, 1);
+    }
+}
+
+/* While a fullscreen client has the focused monitor, dwm stops selecting
+ * pointer motion on the root window, so that games and videos are not
+ * disturbed by the window manager waking up. */
+void updatefsmode(program_state *state) {
+  int on = barcovered(selmon);
+
+  if (on == fsmode)
+    return;
+  fsmode = on;
+  updaterootmask(state);
+}
+
 int updategeom(program_state *state) {
   int dirty = 0;
+  Monitor *m;
 
 #ifdef XINERAMA
   if (XineramaIsActive(dpy)) {
@@ -1660,6 +3080,7 @@ int updategeom(program_state *state) {
     XineramaScreenInfo *info = XineramaQueryScreens(dpy, &nn);
     XineramaScreenInfo *unique = NULL;
 
+    alloc_count(info, "XineramaQueryScreens");
     for (n = 0, m = mons; m; m = m->next, n++)
       ;
     /* only consider unique geometries as separate screens */
@@ -1667,7 +3088,7 @@ int updategeom(program_state *state) {
     for (i = 0, j = 0; i < nn; i++)
       if (isuniquegeom(unique, j, &info[i]))
         memcpy(&unique[j++], &info[i], sizeof(XineramaScreenInfo));
-    XFree(info);
+    xfree(info);
     nn = j;
 
     /* new monitors if nn > n */
@@ -1683,6 +3104,7 @@ int updategeom(program_state *state) {
       if (i >= n || unique[i].x_org != m->mx || unique[i].y_org != m->my ||
           unique[i].width != m->mw || unique[i].height != m->mh) {
         dirty = 1;
+        m->dirty |= DirtyAll;
         m->num = i;
         m->mx = m->wx = unique[i].x_org;
         m->my = m->wy = unique[i].y_org;
@@ -1696,6 +3118,7 @@ int updategeom(program_state *state) {
         ;
       while ((c = m->clients)) {
         dirty = 1;
+        mons->dirty |= DirtyLayout | DirtyVisibility | DirtyBar;
         m->clients = c->next;
         detachstack(c);
         c->mon = mons;
@@ -1714,11 +3137,22 @@ int updategeom(program_state *state) {
       mons = createmon();
     if (mons->mw != sw || mons->mh != sh) {
       dirty = 1;
+      mons->dirty |= DirtyAll;
       mons->mw = mons->ww = sw;
       mons->mh = mons->wh = sh;
       updatebarpos(mons);
     }
   }
+  if (dirty || !mongrid) {
+    grid_free(mongrid);
+    grid_free(wingrid);
+    mongrid = grid_create(sw, sh, GRIDCELL);
+    wingrid = grid_create(sw, sh, GRIDCELL);
+    wingridstale = 1;
+    /* the whole monitor, the bar may come and go without updategeom() */
+    for (m = mons; m; m = m->next)
+      grid_insert(mongrid, m->mx, m->my, m->mw, m->mh, m);
+  }
   if (dirty) {
     selmon = mons;
     selmon = wintomon(state, root);
@@ -1740,6 +3174,23 @@ void updatenumlockmask(program_state *state) {
   XFreeModifiermap(modmap);
 }
 
+/* Selects on root only what dwm uses with the monitors it has: pointer
+ * motion and crossing events move the focus between monitors, so a single
+ * monitor or click to focus does without them. */
+void updaterootmask(program_state *state) {
+  long mask = ROOTMASK;
+
+  if (focusfollowsmouse && mons && mons->next) {
+    mask |= EnterWindowMask;
+    if (!fsmode)
+      mask |= PointerMotionMask;
+  }
+  if (mask == rootmask)
+    return;
+  rootmask = mask;
+  XSelectInput(state->dpy, root, mask);
+}
+
 void updatesizehints(program_state *state, Client *c) {
   long msize;
   XSizeHints size;
@@ -1747,45 +3198,76 @@ void updatesizehints(program_state *state, Client *c) {
   if (!XGetWMNormalHints(state->dpy, c->win, &size, &msize))
     /* size is uninitialized, ensure that size.flags aren't used */
     size.flags = PSize;
-  if (size.flags & PBaseSize) {
-    c->basew = size.base_width;
-    c->baseh = size.base_height;
-  } else if (size.flags & PMinSize) {
-    c->basew = size.min_width;
-    c->baseh = size.min_height;
-  } else
-    c->basew = c->baseh = 0;
-  if (size.flags & PResizeInc) {
-    c->incw = size.width_inc;
-    c->inch = size.height_inc;
-  } else
-    c->incw = c->inch = 0;
-  if (size.flags & PMaxSize) {
-    c->maxw = size.max_width;
-    c->maxh = size.max_height;
-  } else
-    c->maxw = c->maxh = 0;
-  if (size.flags & PMinSize) {
-    c->minw = size.min_width;
-    c->minh = size.min_height;
-  } else if (size.flags & PBaseSize) {
-    c->minw = size.base_width;
-    c->minh = size.base_height;
-  } else
-    c->minw = c->minh = 0;
-  if (size.flags & PAspect) {
-    c->mina = (float)size.min_aspect.y / size.min_aspect.x;
-    c->maxa = (float)size.max_aspect.x / size.max_aspect.y;
-  } else
-    c->maxa = c->mina = 0.0;
-  c->isfixed = (c->maxw && c->maxh && c->maxw == c->minw && c->maxh == c->minh);
-  c->hintsvalid = 1;
+  setsizehints(c, &size);
+}
+
+/* publishes the state to readers of the shared memory segment */
+void updatesnapshot(void) {
+  ShmState *st;
+  ShmMonitor *sm;
+  ShmClient *sc;
+  Monitor *m;
+  Client *c;
+  size_t len;
+  unsigned int nmons = 0, nclients = 0;
+
+  if (!shm)
+    return;
+  for (m = mons; m; m = m->next, nmons++)
+    for (c = m->clients; c; c = c->next)
+      nclients++;
+  len = sizeof(ShmState) + nmons * sizeof(ShmMonitor) +
+        nclients * sizeof(ShmClient);
+  if (len > snapcap) {
+    snapcap = 2 * len;
+    snapbuf = erealloc(snapbuf, snapcap);
+  }
+  memset(snapbuf, 0, len);
+  st = (ShmState *)snapbuf;
+  sm = (ShmMonitor *)(st + 1);
+  sc = (ShmClient *)(sm + nmons);
+  st->nmons = nmons;
+  st->nclients = nclients;
+  st->selmon = selmon->num;
+  for (m = mons; m; m = m->next, sm++) {
+    sm->num = m->num;
+    sm->mx = m->mx;
+    sm->my = m->my;
+    sm->mw = m->mw;
+    sm->mh = m->mh;
+    sm->wx = m->wx;
+    sm->wy = m->wy;
+    sm->ww = m->ww;
+    sm->wh = m->wh;
+    sm->tagset = m->tagset[m->seltags];
+    sm->sel = m->sel ? m->sel->win : 0;
+    sm->mfact = m->mfact;
+    sm->nmaster = m->nmaster;
+    sm->showbar = m->showbar;
+    strncpy(sm->ltsymbol, m->ltsymbol, sizeof sm->ltsymbol - 1);
+    for (c = m->clients; c; c = c->next, sc++) {
+      sc->win = c->win;
+      sc->tags = c->tags;
+      sc->mon = m->num;
+      sc->x = c->x;
+      sc->y = c->y;
+      sc->w = c->w;
+      sc->h = c->h;
+      sc->flags = (c->isfloating ? IpcFloating : 0) |
+                  (c->isfullscreen ? IpcFullscreen : 0) |
+                  (c->isurgent ? IpcUrgent : 0) |
+                  (c == selmon->sel ? IpcFocused : 0);
+    }
+  }
+  shm_publish(shm, snapbuf, len);
 }
 
 void updatestatus(program_state *state) {
+  if (statusfd >= 0)
+    return;
   if (!gettextprop(state, root, XA_WM_NAME, stext, sizeof(stext)))
     strcpy(stext, "dwm-" VERSION);
-  drawbar(selmon);
+  invalidatebar(selmon);
 }
 
 void updatetitle(program_state *state, Client *c) {
@@ -1796,29 +3278,17 @@ void updatetitle(program_state *state, Client *c) {
 }
 
 void updatewindowtype(program_state *state, Client *c) {
-  Atom _state = getatomprop(state, c, netatom[NetWMState]);
-  Atom wtype = getatomprop(state, c, netatom[NetWMWindowType]);
-
-  if (_state == netatom[NetWMFullscreen])
-    setfullscreen(state, c, 1);
-  if (wtype == netatom[NetWMWindowTypeDialog])
-    c->isfloating = 1;
+  setwindowtype(state, c, getatomprop(state, c, netatom[NetWMState]),
+                getatomprop(state, c, netatom[NetWMWindowType]));
 }
 
 void updatewmhints(program_state *state, Client *c) {
   XWMHints *wmh;
 
   if ((wmh = XGetWMHints(state->dpy, c->win))) {
-    if (c == selmon->sel && wmh->flags & XUrgencyHint) {
-      wmh->flags &= ~XUrgencyHint;
-      XSetWMHints(state->dpy, c->win, wmh);
-    } else
-      c->isurgent = (wmh->flags & XUrgencyHint) ? 1 : 0;
-    if (wmh->flags & InputHint)
-      c->neverfocus = !wmh->input;
-    else
-      c->neverfocus = 0;
-    XFree(wmh);
+    alloc_count(wmh, "XGetWMHints");
+    setwmhints(state, c, wmh);
+    xfree(wmh);
   }
 }
 
@@ -1832,6 +3302,23 @@ void view(program_state *state, const Arg *arg) {
   arrange(state, selmon);
 }
 
+pid_t winpid(program_state *state, Window w) {
+  int di;
+  unsigned long dl;
+  unsigned char *p = NULL;
+  Atom da;
+  pid_t pid = 0;
+
+  if (XGetWindowProperty(state->dpy, w, netatom[NetWMPid], 0L, 1L, False,
+                         XA_CARDINAL, &da, &di, &dl, &dl, &p) == Success &&
+      p) {
+    alloc_count(p, "XGetWindowProperty");
+    pid = *(long *)p;
+    xfree(p);
+  }
+  return pid;
+}
+
 Client *wintoclient(Window w) {
   Client *c;
   Monitor *m;
@@ -1901,6 +3388,9 @@ void check_ussage(int argc, char *argv[]) {
     die("dwm-" VERSION);
   else if (argc != 1)
     die("usage: dwm [-v]");
+  /* argv may not outlive main() or be NULL-terminated */
+  dwmargv = ecalloc(argc + 1, sizeof(char *));
+  memcpy(dwmargv, argv, argc * sizeof(char *));
 }
 
 program_state *init_state(void) {
@@ -1913,6 +3403,29 @@ program_state *init_state(void) {
   return state;
 }
 void free_state(program_state *state) {
+#ifdef ALLOCSTATS
+  AllocTotals t;
+#endif
+
   XCloseDisplay(state->dpy);
   free(state);
+#ifdef ALLOCSTATS
+  /* everything of ours is freed by now, unless the next process needs it */
+  if (restarting)
+    return;
+  free(dwmargv);
+  alloc_totals(&t);
+  if (t.live) {
+    fprintf(stderr, "dwm: %zu allocations leaked\n", t.live);
+    alloc_dump();
+  }
+#endif
+}
+
+/* replaces the process after restart(), once the display is closed */
+void reexec(void) {
+  if (!restarting)
+    return;
+  execvp(dwmargv[0], dwmargv);
+  die("dwm: execvp '%s' failed:", dwmargv[0]);
 }
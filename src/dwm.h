@@ -22,8 +22,24 @@
 #include <X11/Xft/Xft.h>
 
 #include "drw.h"
+#include "ipc.h"
+#include "loop.h"
+#include "status.h"
 #include "util.h"
 
+/* enums used by config.h */
+enum { SchemeNorm, SchemeSel, SchemeLast }; /* color schemes */
+enum { HideMove, HideIconic, HideUnmap }; /* hidemode */
+enum {
+  ClkTagBar,
+  ClkLtSymbol,
+  ClkStatusText,
+  ClkWinTitle,
+  ClkClientWin,
+  ClkRootWin,
+  ClkLast
+}; /* clicks */
+
 typedef struct internal_state program_state;
 typedef union {
   int i;
@@ -42,6 +58,17 @@ typedef struct {
 
 typedef struct Monitor Monitor;
 typedef struct Client Client;
+
+/* token bucket of one kind of property update, see throttle() */
+typedef struct {
+  Timer timer; /* trailing delivery */
+  program_state *state;
+  Client *c;
+  int slot;
+  long long stamp;    /* last refill, in ms */
+  unsigned int tokens; /* in 1/1000 */
+} Throttle;
+
 struct Client {
   char name[256];
   float mina, maxa;
@@ -51,10 +78,14 @@ struct Client {
   int bw, oldbw;
   unsigned int tags;
   int isfixed, isfloating, isurgent, neverfocus, oldstate, isfullscreen;
+  int ishidden, ignoreunmap; /* see sethidden() */
+  unsigned int pubtags;       /* tags last published, see updatedesktops() */
+  int haspos; /* WM_NORMAL_HINTS has USPosition or PPosition */
   Client *next;
   Client *snext;
   Monitor *mon;
   Window win;
+  Throttle *throttle; /* allocated on the first throttled update */
 };
 
 typedef struct {
@@ -88,8 +119,23 @@ struct Monitor {
   Monitor *next;
   Window barwin;
   const Layout *lt[2];
+  unsigned int dirty; /* Dirty* work pending for arrangedirty() */
+  int titlex, titlew, statusw; /* bar segments of the last drawbar() */
+  unsigned int placeholders; /* segments waiting for a fallback font */
 };
 
+/* a pre-started instance of one of poolcmds */
+typedef struct {
+  pid_t pid;  /* 0 if none */
+  Window win; /* its window, withheld until spawn() adopts it */
+} PoolEnt;
+
+/* a pooled command started by spawn() because no instance was ready */
+typedef struct {
+  pid_t pid;
+  long long t; /* of the spawn(), in us */
+} Launch;
+
 typedef struct {
   const char *class;
   const char *instance;
@@ -99,6 +145,29 @@ typedef struct {
   int monitor;
 } Rule;
 
+/* state handed to the next process by restart(): a SavedState header,
+ * then nmons SavedMonitor and nclients SavedClient records */
+typedef struct {
+  uint32_t version;
+  uint32_t nmons, nclients;
+  int32_t selmon;
+} SavedState;
+
+typedef struct {
+  int32_t num;
+  uint32_t seltags, sellt, tagset[2], lt[2]; /* lt: index into layouts[] */
+  float mfact;
+  int32_t nmaster, showbar;
+} SavedMonitor;
+
+typedef struct {
+  uint32_t win, tags;
+  int32_t mon;
+  int32_t x, y, w, h, oldx, oldy, oldw, oldh, oldbw;
+  int32_t stackpos; /* position in the focus stack */
+  uint8_t isfloating, isfullscreen, oldstate, pad;
+} SavedClient;
+
 
 
 
@@ -107,6 +176,7 @@ typedef struct {
 void applyrules(program_state *state, Client *c);
 int applysizehints(program_state *state,Client *c, int *x, int *y, int *w, int *h, int interact);
 void arrange(program_state *state,Monitor *m);
+void arrangedirty(program_state *state);
 void arrangemon(program_state *state,Monitor *m);
 void attach(Client *c);
 void attachstack(Client *c);
@@ -116,6 +186,7 @@ void cleanup(program_state *state);
 void cleanupmon(program_state *state,Monitor *mon);
 void clientmessage(program_state *state,XEvent *e);
 void configure(program_state *state,Client *c);
+void copytextprop(program_state *state,XTextProperty *name, char *text, unsigned int size);
 void configurenotify(program_state *state,XEvent *e);
 void configurerequest(program_state *state,XEvent *e);
 Monitor *createmon(void);
@@ -124,13 +195,16 @@ void detach(Client *c);
 void detachstack(Client *c);
 Monitor *dirtomon(int dir);
 void drawbar(Monitor *m);
-void drawbars(void);
+void drawstatus(Monitor *m);
+void drawtitle(Monitor *m);
 void enternotify(program_state *state,XEvent *e);
 void expose(program_state *state,XEvent *e);
+void flushbars(void);
 void focus(program_state *state,Client *c);
 void focusin(program_state *state,XEvent *e);
 void focusmon(program_state *state, const Arg *arg);
 void focusstack(program_state *state,const Arg *arg);
+void fontready(int fd, void *arg);
 Atom getatomprop(program_state *state,Client *c, Atom prop);
 int getrootptr(program_state *state,int *x, int *y);
 long getstate(program_state *state, Window w);
@@ -138,35 +212,53 @@ int gettextprop(program_state *state,Window w, Atom atom, char *text, unsigned i
 void grabbuttons(program_state *state,Client *c, int focused);
 void grabkeys(program_state *state);
 void incnmaster(program_state *state,const Arg *arg);
+void invalidatebar(Monitor *m);
+void invalidatebars(void);
+void ipccommand(void *arg, int fd, const IpcMsg *msg);
 void keypress(program_state *state,XEvent *e);
 void killclient(program_state *state,const Arg *arg);
 void manage(program_state *state,Window w, XWindowAttributes *wa);
 void mappingnotify(program_state *state,XEvent *e);
 void maprequest(program_state *state,XEvent *e);
+void matchrules(Client *c, const char *class, const char *instance);
 void monocle(program_state *state,Monitor *m);
 void motionnotify(program_state *state,XEvent *e);
 void movemouse(program_state *state,const Arg *arg);
 Client *nexttiled(Client *c);
+void poolfill(program_state *state, unsigned int i);
+int poolwithhold(Window w, pid_t pid);
 void pop(program_state *state,Client *c);
 void propertynotify(program_state *state,XEvent *e);
+void propertyupdate(program_state *state, Client *c, int slot);
 void quit(program_state *state,const Arg *arg);
 Monitor *recttomon(int x, int y, int w, int h);
 void resize(program_state *state,Client *c, int x, int y, int w, int h, int interact);
 void resizeclient(program_state *state,Client *c, int x, int y, int w, int h);
 void resizemouse(program_state *state,const Arg *arg);
 void restack(program_state *state,Monitor *m);
+void restart(program_state *state, const Arg *arg);
+void restoreclient(Client *c, const SavedClient *sc);
+void restoremonitors(program_state *state);
 void run(program_state *state);
+void savestate(program_state *state);
 void scan(program_state *state);
 int sendevent(program_state *state,Client *c, Atom proto);
 void sendmon(program_state *state,Client *c, Monitor *m);
 void setclientstate(program_state *state,Client *c, long i_state);
 void setfocus(program_state *state,Client *c);
 void setfullscreen(program_state *state,Client *c, int fullscreen);
+void sethidden(program_state *state, Client *c, int hidden);
 void setlayout(program_state *state,const Arg *arg);
 void setmfact(program_state *state,const Arg *arg);
+void setnetwmstate(program_state *state, Client *c);
+void setpalette(program_state *state, const Arg *arg);
+void setsizehints(Client *c, XSizeHints *size);
 void setup(program_state *state);
 void seturgent(program_state *state,Client *c, int urg);
+void setwindowtype(program_state *state,Client *c, Atom wstate, Atom wtype);
+void setwmhints(program_state *state,Client *c, XWMHints *wmh);
 void showhide(program_state *state,Client *c);
+void sigchld(int sig, void *arg);
 void spawn(program_state *state,const Arg *arg);
 void tag   (program_state *state,const Arg *arg);
 void tagmon(program_state *state,const Arg *arg);
@@ -181,14 +273,19 @@ void unmapnotify(program_state *state,XEvent *e);
 void updatebarpos(Monitor *m);
 void updatebars(program_state *state);
 void updateclientlist(program_state *state);
+void updatedesktops(program_state *state);
+void updatefsmode(program_state *state);
 int updategeom(program_state *state);
 void updatenumlockmask(program_state *state);
+void updaterootmask(program_state *state);
 void updatesizehints(program_state *state,Client *c);
+void updatesnapshot(void);
 void updatestatus(program_state *state);
 void updatetitle(program_state *state,Client *c);
 void updatewindowtype(program_state *state,Client *c);
 void updatewmhints(program_state *state,Client *c);
 void view(program_state *state,const Arg *arg);
+pid_t winpid(program_state *state, Window w);
 Client *wintoclient(Window w);
 Monitor *wintomon(program_state *state,Window w);
 int xerror(Display *dpy, XErrorEvent *ee);
@@ -198,4 +295,5 @@ void zoom(program_state *state,const Arg *arg);
 void check_ussage(int argc, char *argv[]);
 program_state *init_state(void);
 void free_state(program_state *state);
+void reexec(void);
 #endif // dwm_h
@@ -54,10 +54,15 @@ pub const Client = extern struct {
     neverfocus: c_int,
     oldstate: c_int,
     isfullscreen: c_int,
+    ishidden: c_int,
+    ignoreunmap: c_int,
+    pubtags: c_uint,
+    haspos: c_int,
     next: ?*Client,
     snext: ?*Client,
     mon: ?*x11.Monitor,
     win: x11.Window,
+    throttle: ?*anyopaque,
 };
 pub const Key = extern struct {
     mod: c_uint,
@@ -97,6 +102,11 @@ pub const Monitor = extern struct {
     next: ?*Monitor,
     barwin: x11.Window,
     lt: [2]?*const Layout,
+    dirty: c_uint,
+    titlex: c_int,
+    titlew: c_int,
+    statusw: c_int,
+    placeholders: c_uint,
 };
 
 pub const Rule = extern struct {
@@ -111,6 +121,7 @@ pub const Rule = extern struct {
 const dwm = struct {
     extern fn init_state() ?*ProgramState;
     extern fn free_state(state: ?*ProgramState) void;
+    extern fn reexec() void;
     extern fn check_ussage(argc: i32, argv: [*][*:0]const u8) void;
     extern fn checkotherwm(state: ?*ProgramState) void;
     extern fn setup(state: ?*ProgramState) void;
@@ -138,7 +149,6 @@ const dwm = struct {
     // void detachstack(Client *c);
     // Monitor *dirtomon(int dir);
     // void drawbar(Monitor *m);
-    // void drawbars(void);
     // void enternotify(program_state *state,XEvent *e);
     // void expose(program_state *state,XEvent *e);
     // void focus(program_state *state,Client *c);
@@ -212,6 +222,7 @@ const dwm = struct {
 
 pub const initState = dwm.init_state;
 pub const freeState = dwm.free_state;
+pub const reexec = dwm.reexec;
 pub const checkUssage = dwm.check_ussage;
 pub const checkOtherWm = dwm.checkotherwm;
 pub const setup = dwm.setup;
@@ -0,0 +1,129 @@
+/* See LICENSE file for copyright and license details. */
+#include <stdlib.h>
+
+#include "grid.h"
+#include "util.h"
+
+typedef struct {
+	size_t *item;
+	size_t n, cap;
+} Cell;
+
+struct Grid {
+	int cols, rows, cell;
+	Cell *cells;
+	GridItem *items;
+	unsigned int *mark; /* query stamp of each item, reports it once */
+	size_t nitems, cap;
+	const GridItem **hits;
+	size_t hitcap;
+	unsigned int stamp;
+};
+
+Grid *
+grid_create(int w, int h, int cell)
+{
+	Grid *g = ecalloc(1, sizeof(Grid));
+
+	g->cell = cell;
+	g->cols = MAX(1, (w + cell - 1) / cell);
+	g->rows = MAX(1, (h + cell - 1) / cell);
+	g->cells = ecalloc(g->cols * g->rows, sizeof(Cell));
+	return g;
+}
+
+void
+grid_free(Grid *g)
+{
+	int i;
+
+	if (!g)
+		return;
+	for (i = 0; i < g->cols * g->rows; i++)
+		free(g->cells[i].item);
+	free(g->cells);
+	free(g->items);
+	free(g->mark);
+	free(g->hits);
+	free(g);
+}
+
+void
+grid_clear(Grid *g)
+{
+	int i;
+
+	for (i = 0; i < g->cols * g->rows; i++)
+		g->cells[i].n = 0;
+	g->nitems = 0;
+}
+
+/* cells covered by the rectangle, clamped to the grid */
+static void
+span(Grid *g, int x, int y, int w, int h, int *c0, int *r0, int *c1, int *r1)
+{
+	*c0 = MAX(0, MIN(g->cols - 1, x / g->cell));
+	*r0 = MAX(0, MIN(g->rows - 1, y / g->cell));
+	*c1 = MAX(0, MIN(g->cols - 1, (x + MAX(w, 1) - 1) / g->cell));
+	*r1 = MAX(0, MIN(g->rows - 1, (y + MAX(h, 1) - 1) / g->cell));
+}
+
+void
+grid_insert(Grid *g, int x, int y, int w, int h, void *data)
+{
+	int c, r, c0, r0, c1, r1;
+	Cell *cell;
+
+	if (g->nitems == g->cap) {
+		g->cap = MAX(16, 2 * g->cap);
+		g->items = erealloc(g->items, g->cap * sizeof(GridItem));
+		g->mark = erealloc(g->mark, g->cap * sizeof(unsigned int));
+		g->hits = erealloc(g->hits, g->cap * sizeof(GridItem *));
+	}
+	g->items[g->nitems] = (GridItem){ x, y, w, h, data };
+	g->mark[g->nitems] = g->stamp;
+	span(g, x, y, w, h, &c0, &r0, &c1, &r1);
+	for (r = r0; r <= r1; r++)
+		for (c = c0; c <= c1; c++) {
+			cell = &g->cells[r * g->cols + c];
+			if (cell->n == cell->cap) {
+				cell->cap = MAX(4, 2 * cell->cap);
+				cell->item = erealloc(cell->item, cell->cap * sizeof(size_t));
+			}
+			cell->item[cell->n++] = g->nitems;
+		}
+	g->nitems++;
+}
+
+/* Sets *hits to the items overlapping the rectangle and returns their
+ * number. The array is valid until the next call. */
+size_t
+grid_query(Grid *g, int x, int y, int w, int h, const GridItem ***hits)
+{
+	int c, r, c0, r0, c1, r1;
+	size_t i, n = 0;
+	Cell *cell;
+	GridItem *it;
+
+	if (!++g->stamp) { /* wrapped, forget all marks */
+		for (i = 0; i < g->nitems; i++)
+			g->mark[i] = 0;
+		g->stamp = 1;
+	}
+	span(g, x, y, w, h, &c0, &r0, &c1, &r1);
+	for (r = r0; r <= r1; r++)
+		for (c = c0; c <= c1; c++) {
+			cell = &g->cells[r * g->cols + c];
+			for (i = 0; i < cell->n; i++) {
+				if (g->mark[cell->item[i]] == g->stamp)
+					continue;
+				g->mark[cell->item[i]] = g->stamp;
+				it = &g->items[cell->item[i]];
+				if (it->x < x + w && x < it->x + it->w &&
+				    it->y < y + h && y < it->y + it->h)
+					g->hits[n++] = it;
+			}
+		}
+	*hits = g->hits;
+	return n;
+}
@@ -0,0 +1,21 @@
+/* See LICENSE file for copyright and license details. */
+#ifndef dwm_grid_h
+#define dwm_grid_h
+#include <stddef.h>
+
+/* Uniform grid of square cells over the root window, to find the windows
+ * or monitors near a rectangle without looking at all of them. Rectangles
+ * reaching outside the grid are kept in its border cells. */
+typedef struct {
+	int x, y, w, h;
+	void *data;
+} GridItem;
+
+typedef struct Grid Grid;
+
+Grid *grid_create(int w, int h, int cell);
+void grid_free(Grid *g);
+void grid_clear(Grid *g);
+void grid_insert(Grid *g, int x, int y, int w, int h, void *data);
+size_t grid_query(Grid *g, int x, int y, int w, int h, const GridItem ***hits);
+#endif // dwm_grid_h
@@ -0,0 +1,211 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "ipc.h"
+#include "loop.h"
+#include "util.h"
+
+#define IPC_MAXCONNS 16
+#define IPC_MAXBATCH 1024 /* messages per transaction */
+#define IPC_BUFSIZ   (64 * sizeof(IpcMsg))
+
+typedef struct {
+	int fd;
+	Ipc *ipc;
+	unsigned char buf[IPC_BUFSIZ];
+	size_t len;
+	int txn;       /* open IpcBegin levels */
+	IpcMsg *batch; /* messages queued since the outermost IpcBegin */
+	size_t nbatch;
+} IpcConn;
+
+struct Ipc {
+	int fd;
+	struct sockaddr_un addr;
+	IpcConn conn[IPC_MAXCONNS];
+	IpcHandler handler;
+	void *arg;
+};
+
+static int
+setflags(int fd)
+{
+	return fcntl(fd, F_SETFD, FD_CLOEXEC) < 0 ||
+	       fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ? -1 : 0;
+}
+
+static void accept_conn(int fd, void *arg);
+
+/* Listens on path and calls h once per request from within loop_wait(). */
+Ipc *
+ipc_create(const char *path, IpcHandler h, void *arg)
+{
+	Ipc *ipc;
+	int fd, i;
+	mode_t mask;
+
+	if (!path || !*path)
+		return NULL;
+	ipc = ecalloc(1, sizeof(Ipc));
+	ipc->handler = h;
+	ipc->arg = arg;
+	for (i = 0; i < IPC_MAXCONNS; i++)
+		ipc->conn[i].fd = -1;
+	ipc->addr.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(ipc->addr.sun_path)) {
+		fprintf(stderr, "dwm: ipc socket path too long: '%s'\n", path);
+		goto err;
+	}
+	strcpy(ipc->addr.sun_path, path);
+
+	/* refuse to take over the socket of a running instance */
+	if ((fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0)
+		goto err;
+	if (!connect(fd, (struct sockaddr *)&ipc->addr, sizeof(ipc->addr))) {
+		fprintf(stderr, "dwm: ipc socket '%s' is in use\n", path);
+		close(fd);
+		goto err;
+	}
+	close(fd);
+	unlink(path);
+
+	if ((ipc->fd = socket(AF_UNIX, SOCK_STREAM, 0)) < 0 || setflags(ipc->fd) < 0)
+		goto err;
+	mask = umask(077);
+	i = bind(ipc->fd, (struct sockaddr *)&ipc->addr, sizeof(ipc->addr));
+	umask(mask);
+	if (i < 0 || listen(ipc->fd, IPC_MAXCONNS) < 0) {
+		fprintf(stderr, "dwm: cannot listen on '%s': %s\n", path, strerror(errno));
+		close(ipc->fd);
+		goto err;
+	}
+	loop_watch(ipc->fd, accept_conn, ipc);
+	return ipc;
+err:
+	free(ipc);
+	return NULL;
+}
+
+static void
+conn_close(IpcConn *c)
+{
+	loop_unwatch(c->fd);
+	close(c->fd);
+	free(c->batch);
+	memset(c, 0, sizeof(*c));
+	c->fd = -1;
+}
+
+void
+ipc_free(Ipc *ipc)
+{
+	int i;
+
+	if (!ipc)
+		return;
+	for (i = 0; i < IPC_MAXCONNS; i++)
+		if (ipc->conn[i].fd >= 0)
+			conn_close(&ipc->conn[i]);
+	loop_unwatch(ipc->fd);
+	close(ipc->fd);
+	unlink(ipc->addr.sun_path);
+	free(ipc);
+}
+
+static void read_conn(int fd, void *arg);
+
+static void
+accept_conn(int lfd, void *arg)
+{
+	Ipc *ipc = arg;
+	int fd, i;
+
+	if ((fd = accept(lfd, NULL, NULL)) < 0)
+		return;
+	for (i = 0; i < IPC_MAXCONNS && ipc->conn[i].fd >= 0; i++)
+		;
+	if (i == IPC_MAXCONNS || setflags(fd) < 0) {
+		close(fd);
+		return;
+	}
+	ipc->conn[i].fd = fd;
+	ipc->conn[i].ipc = ipc;
+	loop_watch(fd, read_conn, &ipc->conn[i]);
+}
+
+/* returns 0 if the connection has to be dropped */
+static int
+handle(IpcConn *c, const IpcMsg *msg, IpcHandler h, void *arg)
+{
+	size_t i;
+
+	if (!c->txn && msg->op != IpcBegin) {
+		h(arg, c->fd, msg);
+		return 1;
+	}
+	if (!c->batch)
+		c->batch = ecalloc(IPC_MAXBATCH, sizeof(IpcMsg));
+	if (c->nbatch == IPC_MAXBATCH)
+		return 0;
+	c->batch[c->nbatch++] = *msg;
+	if (msg->op == IpcBegin)
+		c->txn++;
+	else if (msg->op == IpcCommit && !--c->txn) {
+		for (i = 0; i < c->nbatch; i++)
+			h(arg, c->fd, &c->batch[i]);
+		c->nbatch = 0;
+	}
+	return 1;
+}
+
+static void
+read_conn(int fd, void *arg)
+{
+	IpcConn *c = arg;
+	ssize_t n;
+	size_t off;
+	IpcMsg msg;
+
+	if ((n = read(c->fd, c->buf + c->len, sizeof(c->buf) - c->len)) <= 0) {
+		if (n == 0 || (errno != EAGAIN && errno != EINTR))
+			conn_close(c);
+		return;
+	}
+	c->len += n;
+	for (off = 0; off + sizeof(msg) <= c->len; off += sizeof(msg)) {
+		memcpy(&msg, c->buf + off, sizeof(msg));
+		if (!handle(c, &msg, c->ipc->handler, c->ipc->arg)) {
+			conn_close(c);
+			return;
+		}
+	}
+	memmove(c->buf, c->buf + off, c->len - off);
+	c->len -= off;
+}
+
+/* Connections are non-blocking; a peer that does not drain its replies is
+ * shut down rather than stalling the window manager. */
+void
+ipc_reply(int fd, uint8_t op, uint8_t status, uint32_t count, const void *data, uint32_t len)
+{
+	IpcReply r = { op, status, { 0 }, count, len };
+	struct iovec iov[2] = { { &r, sizeof(r) }, { (void *)data, len } };
+	struct msghdr mh = { 0 };
+	ssize_t n;
+
+	if (fd < 0)
+		return;
+	mh.msg_iov = iov;
+	mh.msg_iovlen = len ? 2 : 1;
+	if ((n = sendmsg(fd, &mh, MSG_NOSIGNAL)) < 0 || (size_t)n != sizeof(r) + len)
+		shutdown(fd, SHUT_RDWR);
+}
@@ -0,0 +1,113 @@
+/* See LICENSE file for copyright and license details. */
+#ifndef dwm_ipc_h
+#define dwm_ipc_h
+
+#include <stdint.h>
+
+/* Wire format of the command socket. A request is one fixed-size IpcMsg and
+ * is answered by one IpcReply, followed by len bytes of payload made of count
+ * records. Everything is in host byte order; the socket is local only.
+ *
+ * Messages sent between IpcBegin and the matching IpcCommit are queued and
+ * run together at commit, with a single arrange, restack and bar redraw per
+ * touched monitor. A transaction left open when the connection closes is
+ * discarded. */
+enum {
+	IpcView,           /* arg.ui: tag mask */
+	IpcToggleView,     /* arg.ui: tag mask */
+	IpcTag,            /* arg.ui: tag mask */
+	IpcToggleTag,      /* arg.ui: tag mask */
+	IpcFocusStack,     /* arg.i: direction */
+	IpcFocusMon,       /* arg.i: direction */
+	IpcTagMon,         /* arg.i: direction */
+	IpcIncNMaster,     /* arg.i: delta */
+	IpcSetMFact,       /* arg.f: delta, or 1.0 + absolute value */
+	IpcSetLayout,      /* arg.i: index into layouts[], < 0 toggles */
+	IpcZoom,
+	IpcKillClient,
+	IpcToggleFloating,
+	IpcToggleBar,
+	IpcQuit,
+	IpcBegin,
+	IpcCommit,
+	IpcGetMonitors,    /* payload: IpcMonitor records */
+	IpcGetClients,     /* payload: IpcClient records */
+	IpcRestart,
+	IpcGetMetrics,     /* payload: one IpcMetrics record */
+	IpcLast
+}; /* request ops */
+
+enum { IpcOk, IpcErrOp, IpcErrArg }; /* reply status */
+
+enum {
+	IpcFloating   = 1 << 0,
+	IpcFullscreen = 1 << 1,
+	IpcUrgent     = 1 << 2,
+	IpcFocused    = 1 << 3,
+}; /* IpcClient flags */
+
+typedef struct {
+	uint8_t op;
+	uint8_t pad[3];
+	union {
+		int32_t i;
+		uint32_t ui;
+		float f;
+	} arg;
+} IpcMsg;
+
+typedef struct {
+	uint8_t op;
+	uint8_t status;
+	uint8_t pad[2];
+	uint32_t count;
+	uint32_t len;
+} IpcReply;
+
+typedef struct {
+	int32_t num;
+	int32_t mx, my, mw, mh;
+	int32_t wx, wy, ww, wh;
+	uint32_t tagset;
+	uint32_t layout;
+	float mfact;
+	int32_t nmaster;
+	uint32_t sel;      /* focused window or 0 */
+	uint8_t selected;  /* is the focused monitor */
+	uint8_t showbar;
+	uint8_t pad[2];
+} IpcMonitor;
+
+typedef struct {
+	uint32_t win;
+	uint32_t tags;
+	int32_t mon;
+	int32_t x, y, w, h;
+	uint32_t flags;
+} IpcClient;
+
+typedef struct {
+	uint32_t maps;     /* windows of pooled commands mapped by spawn() */
+	uint32_t poolhits; /* of them, instances taken from the pool */
+	uint32_t maplast;  /* binding to map, in us */
+	uint32_t mapmax;
+	uint64_t maptotal;
+	uint32_t spawns;    /* commands started */
+	uint32_t spawnlast; /* spawn() to exec, in us */
+	uint32_t spawnmax;
+	uint32_t pad;
+	uint64_t spawntotal;
+	uint64_t alloclive;  /* allocations of dwm not freed, 0 unless */
+	uint64_t allocbytes; /* built with -DALLOCSTATS */
+	uint64_t allocpeak;
+	uint64_t heapbytes;  /* in use by malloc(), libraries included */
+} IpcMetrics;
+
+/* server side */
+typedef struct Ipc Ipc;
+typedef void (*IpcHandler)(void *arg, int fd, const IpcMsg *msg);
+
+Ipc *ipc_create(const char *path, IpcHandler h, void *arg);
+void ipc_free(Ipc *ipc);
+void ipc_reply(int fd, uint8_t op, uint8_t status, uint32_t count, const void *data, uint32_t len);
+#endif // dwm_ipc_h
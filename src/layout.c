@@ -0,0 +1,121 @@
+/* See LICENSE file for copyright and license details. */
+#include "layout.h"
+#include "util.h"
+
+/* Fits r, the requested geometry of c, to its size hints and keeps it
+ * from leaving bounds entirely: the screen when the user moves or resizes
+ * the window interactively, its monitor's window area otherwise. No side
+ * is made smaller than minsize. Returns whether r differs from the
+ * current geometry. */
+int
+layout_hints(const LayoutClient *c, const LayoutRect *bounds, int interact,
+             int minsize, LayoutRect *r)
+{
+	int baseismin;
+
+	/* set minimum possible */
+	r->w = MAX(1, r->w);
+	r->h = MAX(1, r->h);
+	if (interact) {
+		if (r->x > bounds->x + bounds->w)
+			r->x = bounds->x + bounds->w - (c->w + 2 * c->bw);
+		if (r->y > bounds->y + bounds->h)
+			r->y = bounds->y + bounds->h - (c->h + 2 * c->bw);
+		if (r->x + r->w + 2 * c->bw < bounds->x)
+			r->x = bounds->x;
+		if (r->y + r->h + 2 * c->bw < bounds->y)
+			r->y = bounds->y;
+	} else {
+		if (r->x >= bounds->x + bounds->w)
+			r->x = bounds->x + bounds->w - (c->w + 2 * c->bw);
+		if (r->y >= bounds->y + bounds->h)
+			r->y = bounds->y + bounds->h - (c->h + 2 * c->bw);
+		if (r->x + r->w + 2 * c->bw <= bounds->x)
+			r->x = bounds->x;
+		if (r->y + r->h + 2 * c->bw <= bounds->y)
+			r->y = bounds->y;
+	}
+	if (r->h < minsize)
+		r->h = minsize;
+	if (r->w < minsize)
+		r->w = minsize;
+	if (c->usehints) {
+		/* see last two sentences in ICCCM 4.1.2.3 */
+		baseismin = c->basew == c->minw && c->baseh == c->minh;
+		if (!baseismin) { /* temporarily remove base dimensions */
+			r->w -= c->basew;
+			r->h -= c->baseh;
+		}
+		/* adjust for aspect limits */
+		if (c->mina > 0 && c->maxa > 0) {
+			if (c->maxa < (float)r->w / r->h)
+				r->w = r->h * c->maxa + 0.5;
+			else if (c->mina < (float)r->h / r->w)
+				r->h = r->w * c->mina + 0.5;
+		}
+		if (baseismin) { /* increment calculation requires this */
+			r->w -= c->basew;
+			r->h -= c->baseh;
+		}
+		/* adjust for increment value */
+		if (c->incw)
+			r->w -= r->w % c->incw;
+		if (c->inch)
+			r->h -= r->h % c->inch;
+		/* restore base dimensions */
+		r->w = MAX(r->w + c->basew, c->minw);
+		r->h = MAX(r->h + c->baseh, c->minh);
+		if (c->maxw)
+			r->w = MIN(r->w, c->maxw);
+		if (c->maxh)
+			r->h = MIN(r->h, c->maxh);
+	}
+	return r->x != c->x || r->y != c->y || r->w != c->w || r->h != c->h;
+}
+
+static void
+place(const LayoutClient *c, const LayoutRect *area, int minsize,
+      int x, int y, int w, int h, LayoutRect *r)
+{
+	*r = (LayoutRect){ x, y, w - 2 * c->bw, h - 2 * c->bw };
+	layout_hints(c, area, 0, minsize, r);
+}
+
+void
+layout_monocle(const LayoutRect *area, int minsize,
+               const LayoutClient *c, unsigned int n, LayoutRect *r)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		place(&c[i], area, minsize, area->x, area->y, area->w, area->h, &r[i]);
+}
+
+/* nmaster clients stacked in a column of mfact of the area on the left,
+ * the rest in a column to its right */
+void
+layout_tile(const LayoutRect *area, float mfact, int nmaster, int minsize,
+            const LayoutClient *c, unsigned int n, LayoutRect *r)
+{
+	unsigned int i, h, mw, my, ty, nm = MAX(nmaster, 0);
+
+	if (n == 0)
+		return;
+	if (n > nm)
+		mw = nm ? area->w * mfact : 0;
+	else
+		mw = area->w;
+	for (i = my = ty = 0; i < n; i++)
+		if (i < nm) {
+			h = (area->h - my) / (MIN(n, nm) - i);
+			place(&c[i], area, minsize, area->x, area->y + my, mw, h, &r[i]);
+			if (my + r[i].h + 2 * c[i].bw < area->h)
+				my += r[i].h + 2 * c[i].bw;
+		} else {
+			h = (area->h - ty) / (n - i);
+			place(&c[i], area, minsize, area->x + mw, area->y + ty,
+			      area->w - mw, h, &r[i]);
+			if (ty + r[i].h + 2 * c[i].bw < area->h)
+				ty += r[i].h + 2 * c[i].bw;
+		}
+}
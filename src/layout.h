@@ -0,0 +1,26 @@
+/* See LICENSE file for copyright and license details. */
+#ifndef dwm_layout_h
+#define dwm_layout_h
+
+/* Geometry of the tiled layouts and of ICCCM size hints, kept apart from
+ * X: clients are described by their size, border and hints, and the
+ * results are rectangles for the caller to configure windows with. Sizes
+ * exclude the border, as in the X protocol. */
+typedef struct {
+	int x, y, w, h;
+} LayoutRect;
+
+typedef struct {
+	int x, y, w, h, bw; /* current geometry */
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
+	float mina, maxa;
+	int usehints;       /* honour the hints above, not only minsize */
+} LayoutClient;
+
+int layout_hints(const LayoutClient *c, const LayoutRect *bounds, int interact,
+                 int minsize, LayoutRect *r);
+void layout_monocle(const LayoutRect *area, int minsize,
+                    const LayoutClient *c, unsigned int n, LayoutRect *r);
+void layout_tile(const LayoutRect *area, float mfact, int nmaster, int minsize,
+                 const LayoutClient *c, unsigned int n, LayoutRect *r);
+#endif // dwm_layout_h
@@ -0,0 +1,230 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "loop.h"
+#include "util.h"
+
+#define MAXEVENTS 16
+
+typedef struct Watch {
+	int fd;
+	void (*func)(int fd, void *arg);
+	void *arg;
+	struct Watch *next;
+} Watch;
+
+typedef struct {
+	void (*func)(int sig, void *arg);
+	void *arg;
+} SigHandler;
+
+static int epfd = -1, tfd = -1, sfd = -1;
+static Watch *watches, *dead; /* dead watches are freed after dispatch */
+static Timer *timers;         /* sorted by deadline */
+static Timer *due;            /* taken off timers by ontimer(), to run */
+static sigset_t sigs;
+static SigHandler sighandler[NSIG];
+
+long long
+loop_now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+static void
+armtimerfd(void)
+{
+	struct itimerspec its = { { 0, 0 }, { 0, 0 } };
+
+	if (timers) {
+		/* an all-zero it_value would disarm, so never ask for time 0 */
+		its.it_value.tv_sec = timers->when / 1000;
+		its.it_value.tv_nsec = timers->when % 1000 * 1000000 + 1;
+	}
+	timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void
+ontimer(int fd, void *arg)
+{
+	uint64_t expirations;
+	long long now = loop_now();
+	Timer *t, **tt;
+
+	if (read(fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+		die("dwm: timerfd read:");
+	/* Only the timers due now run: one a callback starts again, even with
+	 * no delay, waits for the next round. Callbacks may stop the others. */
+	for (tt = &timers; *tt && (*tt)->when <= now; tt = &(*tt)->next)
+		;
+	if (tt != &timers) {
+		due = timers;
+		timers = *tt;
+		*tt = NULL;
+	}
+	while ((t = due)) {
+		due = t->next;
+		t->armed = 0;
+		t->func(t->arg);
+	}
+	armtimerfd();
+}
+
+static void
+onsignal(int fd, void *arg)
+{
+	struct signalfd_siginfo si;
+
+	while (read(fd, &si, sizeof(si)) == sizeof(si))
+		if (si.ssi_signo < NSIG && sighandler[si.ssi_signo].func)
+			sighandler[si.ssi_signo].func(si.ssi_signo, sighandler[si.ssi_signo].arg);
+}
+
+void
+loop_init(void)
+{
+	if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+		die("dwm: epoll_create1:");
+	if ((tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+		die("dwm: timerfd_create:");
+	sigemptyset(&sigs);
+	if ((sfd = signalfd(-1, &sigs, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+		die("dwm: signalfd:");
+	loop_watch(tfd, ontimer, NULL);
+	loop_watch(sfd, onsignal, NULL);
+}
+
+void
+loop_free(void)
+{
+	Watch *w;
+
+	while (timers)
+		timer_stop(timers);
+	while (watches)
+		loop_unwatch(watches->fd);
+	while ((w = dead)) {
+		dead = w->next;
+		free(w);
+	}
+	close(tfd);
+	close(sfd);
+	close(epfd);
+	sigprocmask(SIG_UNBLOCK, &sigs, NULL);
+}
+
+/* func may be NULL if the caller only needs loop_wait() to return */
+void
+loop_watch(int fd, void (*func)(int fd, void *arg), void *arg)
+{
+	struct epoll_event ev = { 0 };
+	Watch *w = ecalloc(1, sizeof(Watch));
+
+	w->fd = fd;
+	w->func = func;
+	w->arg = arg;
+	ev.events = EPOLLIN;
+	ev.data.ptr = w;
+	if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0)
+		die("dwm: epoll_ctl:");
+	w->next = watches;
+	watches = w;
+}
+
+void
+loop_unwatch(int fd)
+{
+	Watch **tw, *w;
+
+	for (tw = &watches; *tw && (*tw)->fd != fd; tw = &(*tw)->next)
+		;
+	if (!(w = *tw))
+		return;
+	*tw = w->next;
+	epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+	w->fd = -1;
+	w->next = dead;
+	dead = w;
+}
+
+/* delivers sig through the loop instead of asynchronously */
+void
+loop_signal(int sig, void (*func)(int sig, void *arg), void *arg)
+{
+	sighandler[sig].func = func;
+	sighandler[sig].arg = arg;
+	sigaddset(&sigs, sig);
+	sigprocmask(SIG_BLOCK, &sigs, NULL);
+	if (signalfd(sfd, &sigs, 0) < 0)
+		die("dwm: signalfd:");
+}
+
+/* blocks until at least one watched fd, timer or signal fired and runs its
+ * callback */
+void
+loop_wait(void)
+{
+	struct epoll_event ev[MAXEVENTS];
+	Watch *w;
+	int i, n;
+
+	if ((n = epoll_wait(epfd, ev, MAXEVENTS, -1)) < 0 && errno != EINTR)
+		die("dwm: epoll_wait:");
+	for (i = 0; i < n; i++) {
+		w = ev[i].data.ptr;
+		if (w->fd >= 0 && w->func)
+			w->func(w->fd, w->arg);
+	}
+	while ((w = dead)) {
+		dead = w->next;
+		free(w);
+	}
+}
+
+void
+timer_start(Timer *t, long delay, void (*func)(void *arg), void *arg)
+{
+	Timer **tt;
+
+	timer_stop(t);
+	t->when = loop_now() + delay;
+	t->func = func;
+	t->arg = arg;
+	for (tt = &timers; *tt && (*tt)->when <= t->when; tt = &(*tt)->next)
+		;
+	t->next = *tt;
+	*tt = t;
+	t->armed = 1;
+	if (timers == t)
+		armtimerfd();
+}
+
+void
+timer_stop(Timer *t)
+{
+	Timer **tt;
+
+	if (!t->armed)
+		return;
+	for (tt = &timers; *tt && *tt != t; tt = &(*tt)->next)
+		;
+	if (!*tt) /* stopped by a callback of ontimer() before it ran */
+		for (tt = &due; *tt && *tt != t; tt = &(*tt)->next)
+			;
+	if (*tt)
+		*tt = t->next;
+	t->armed = 0;
+	armtimerfd();
+}
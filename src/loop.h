@@ -0,0 +1,24 @@
+/* See LICENSE file for copyright and license details. */
+#ifndef dwm_loop_h
+#define dwm_loop_h
+
+/* Timers are owned by the caller and must stay valid while armed. */
+typedef struct Timer {
+	long long when; /* CLOCK_MONOTONIC, in ms */
+	int armed;
+	void (*func)(void *arg);
+	void *arg;
+	struct Timer *next;
+} Timer;
+
+void loop_init(void);
+void loop_free(void);
+long long loop_now(void);
+void loop_watch(int fd, void (*func)(int fd, void *arg), void *arg);
+void loop_unwatch(int fd);
+void loop_signal(int sig, void (*func)(int sig, void *arg), void *arg);
+void loop_wait(void);
+
+void timer_start(Timer *t, long delay, void (*func)(void *arg), void *arg);
+void timer_stop(Timer *t);
+#endif // dwm_loop_h
@@ -23,5 +23,6 @@ pub fn main() !void {
     dwm.run(state);
     dwm.cleanup(state);
     dwm.freeState(state);
+    dwm.reexec();
     std.process.exit(0);
 }
@@ -0,0 +1,98 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "shm.h"
+#include "util.h"
+
+struct Shm {
+	int fd;
+	char name[256];
+	ShmHeader *seg;
+	size_t size;
+	void *last; /* what was published last */
+	size_t lastlen;
+};
+
+/* Creates the segment /name; others can only open it for reading. */
+Shm *
+shm_create(const char *name)
+{
+	Shm *shm;
+
+	if (!name || !*name)
+		return NULL;
+	shm = ecalloc(1, sizeof(Shm));
+	snprintf(shm->name, sizeof(shm->name), "/%s", name);
+	shm_unlink(shm->name); /* left over from a crash */
+	if ((shm->fd = shm_open(shm->name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0400)) < 0) {
+		fprintf(stderr, "dwm: cannot create shared memory '%s': %s\n", shm->name, strerror(errno));
+		free(shm);
+		return NULL;
+	}
+	shm->lastlen = -1;
+	return shm;
+}
+
+void
+shm_free(Shm *shm)
+{
+	if (!shm)
+		return;
+	if (shm->seg)
+		munmap(shm->seg, shm->size);
+	close(shm->fd);
+	shm_unlink(shm->name);
+	free(shm->last);
+	free(shm);
+}
+
+/* grows the segment to hold len bytes of snapshot, returns 0 on failure */
+static int
+reserve(Shm *shm, size_t len)
+{
+	size_t size = shm->size ? shm->size : 4096;
+	void *seg;
+
+	while (size < sizeof(ShmHeader) + len)
+		size *= 2;
+	if (size == shm->size)
+		return 1;
+	if (ftruncate(shm->fd, size) < 0 ||
+	    (seg = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0)) == MAP_FAILED)
+		return 0;
+	if (shm->seg)
+		munmap(shm->seg, shm->size);
+	shm->seg = seg;
+	shm->size = size;
+	return 1;
+}
+
+/* Replaces the snapshot if it differs from the last one. */
+void
+shm_publish(Shm *shm, const void *snap, size_t len)
+{
+	ShmHeader *h;
+
+	if (!shm || (len == shm->lastlen && !memcmp(snap, shm->last, len)))
+		return;
+	if (!reserve(shm, len))
+		return;
+	h = shm->seg;
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+	h->version = SHM_VERSION;
+	h->size = shm->size;
+	h->len = len;
+	memcpy(h + 1, snap, len);
+	__atomic_store_n(&h->seq, h->seq + 1, __ATOMIC_RELEASE);
+
+	shm->last = erealloc(shm->last, MAX(len, 1));
+	memcpy(shm->last, snap, len);
+	shm->lastlen = len;
+}
@@ -0,0 +1,81 @@
+/* See LICENSE file for copyright and license details. */
+#ifndef dwm_shm_h
+#define dwm_shm_h
+
+#include <stdint.h>
+#include <string.h>
+
+/* Layout of the read-only shared memory segment dwm publishes its state in,
+ * see shm_open(3). The segment starts with a ShmHeader, followed by len
+ * bytes of snapshot: a ShmState, nmons ShmMonitor and nclients ShmClient
+ * records. Everything is in host byte order.
+ *
+ * dwm rewrites the snapshot after an event batch that changed it. seq is
+ * odd while it does; readers copy the snapshot and retry if seq was odd or
+ * changed meanwhile, which is what shm_read() does. The segment only
+ * grows: a reader whose mapping is smaller than size has to map it anew. */
+#define SHM_VERSION 1
+
+typedef struct {
+	uint32_t seq;
+	uint32_t version; /* SHM_VERSION */
+	uint32_t size;    /* of the segment */
+	uint32_t len;     /* of the snapshot */
+} ShmHeader;
+
+typedef struct {
+	uint32_t nmons, nclients;
+	int32_t selmon;   /* num of the focused monitor */
+	uint32_t pad;
+} ShmState;
+
+typedef struct {
+	int32_t num;
+	int32_t mx, my, mw, mh;
+	int32_t wx, wy, ww, wh;
+	uint32_t tagset;
+	uint32_t sel;     /* focused window or 0 */
+	float mfact;
+	int32_t nmaster;
+	uint8_t showbar;
+	uint8_t pad[3];
+	char ltsymbol[16];
+} ShmMonitor;
+
+typedef struct {
+	uint32_t win;
+	uint32_t tags;
+	int32_t mon;
+	int32_t x, y, w, h;
+	uint32_t flags;   /* IpcFloating and friends, see ipc.h */
+} ShmClient;
+
+/* Copies a consistent snapshot out of seg, mapped with maplen bytes, into
+ * buf and returns its length; 0 if it does not fit into buf or the mapping,
+ * see ShmHeader.size. */
+static inline size_t
+shm_read(const void *seg, size_t maplen, void *buf, size_t bufsize)
+{
+	const ShmHeader *h = seg;
+	uint32_t seq, len;
+
+	for (;;) {
+		if ((seq = __atomic_load_n(&h->seq, __ATOMIC_ACQUIRE)) & 1)
+			continue;
+		len = __atomic_load_n(&h->len, __ATOMIC_RELAXED);
+		if (sizeof(*h) + len > maplen || len > bufsize)
+			return 0;
+		memcpy(buf, h + 1, len);
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if (__atomic_load_n(&h->seq, __ATOMIC_RELAXED) == seq)
+			return len;
+	}
+}
+
+/* server side */
+typedef struct Shm Shm;
+
+Shm *shm_create(const char *name);
+void shm_free(Shm *shm);
+void shm_publish(Shm *shm, const void *snap, size_t len);
+#endif // dwm_shm_h
@@ -0,0 +1,296 @@
+/* See LICENSE file for copyright and license details. */
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "status.h"
+#include "util.h"
+
+#define STATUS_SIZ 256 /* of the joined text, as stext in dwm.c */
+#define PART_SIZ   64  /* of the text of one module */
+#define FRESH      4   /* flags a buffer index in ready */
+
+static const StatusModule *mods;
+static size_t nmods;
+static const char *sep;
+static char (*parts)[PART_SIZ];
+static StatusPrev *prevs;
+static long long *due;
+
+/* Triple buffer: the worker fills buf[back] and swaps it with ready, the
+ * event loop swaps ready with buf[front] when it is FRESH. Neither waits
+ * for the other. */
+static char buf[3][STATUS_SIZ];
+static unsigned int back = 0, ready = 1, front = 2;
+
+static int statusfd = -1;
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER; /* for stop only */
+static pthread_cond_t cond;
+static int stop, running;
+
+static long long
+now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+/* reads the first line of path into s, without the newline */
+static int
+readline(const char *path, char *s, size_t size)
+{
+	FILE *f;
+	int ok;
+
+	if (!(f = fopen(path, "r")))
+		return 0;
+	ok = fgets(s, size, f) != NULL;
+	fclose(f);
+	if (ok)
+		s[strcspn(s, "\n")] = '\0';
+	return ok;
+}
+
+/* n bytes as a short human readable size */
+static void
+human(char *s, size_t size, unsigned long long n)
+{
+	const char *units = "BKMGT";
+
+	if (n < 1024) {
+		snprintf(s, size, "%lluB", n);
+		return;
+	}
+	for (units++; n >= 1024 * 1024 && units[1]; units++)
+		n /= 1024;
+	snprintf(s, size, "%.1f%c", n / 1024.0, *units);
+}
+
+/* arg: name in /sys/class/power_supply, e.g. "BAT0" */
+void
+status_battery(char *buf, size_t size, const char *arg, StatusPrev *prev)
+{
+	char path[128], cap[16], st[32];
+
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/capacity", arg);
+	if (!readline(path, cap, sizeof(cap)))
+		return;
+	snprintf(path, sizeof(path), "/sys/class/power_supply/%s/status", arg);
+	if (!readline(path, st, sizeof(st)))
+		*st = '\0';
+	snprintf(buf, size, "%s%%%s", cap, !strcmp(st, "Charging") ? "+" :
+	         !strcmp(st, "Discharging") ? "-" : "");
+}
+
+/* arg: strftime(3) format */
+void
+status_clock(char *buf, size_t size, const char *arg, StatusPrev *prev)
+{
+	time_t t = time(NULL);
+	struct tm tm;
+
+	if (localtime_r(&t, &tm) && !strftime(buf, size, arg, &tm))
+		*buf = '\0';
+}
+
+/* arg: unused */
+void
+status_load(char *buf, size_t size, const char *arg, StatusPrev *prev)
+{
+	double avg[3];
+
+	if (getloadavg(avg, 3) == 3)
+		snprintf(buf, size, "%.2f %.2f %.2f", avg[0], avg[1], avg[2]);
+}
+
+/* arg: unused; memory in use, without caches */
+void
+status_mem(char *buf, size_t size, const char *arg, StatusPrev *prev)
+{
+	FILE *f;
+	char line[128];
+	unsigned long long total = 0, avail = 0;
+
+	if (!(f = fopen("/proc/meminfo", "r")))
+		return;
+	while (fgets(line, sizeof(line), f))
+		if (sscanf(line, "MemTotal: %llu kB", &total) != 1)
+			sscanf(line, "MemAvailable: %llu kB", &avail);
+	fclose(f);
+	if (total && avail <= total)
+		human(buf, size, (total - avail) * 1024);
+}
+
+/* arg: interface in /proc/net/dev; received and sent bytes per second */
+void
+status_net(char *buf, size_t size, const char *arg, StatusPrev *prev)
+{
+	FILE *f;
+	char line[256], *p, rx[16], tx[16];
+	unsigned long long r, t;
+	size_t len = strlen(arg);
+	long long ms = now();
+	int found = 0;
+
+	if (!(f = fopen("/proc/net/dev", "r")))
+		return;
+	while (!found && fgets(line, sizeof(line), f)) {
+		for (p = line; *p == ' '; p++)
+			;
+		found = !strncmp(p, arg, len) && p[len] == ':' &&
+		        sscanf(p + len + 1, "%llu %*u %*u %*u %*u %*u %*u %*u %llu", &r, &t) == 2;
+	}
+	fclose(f);
+	if (!found)
+		return;
+	if (prev->t && ms > prev->t && r >= prev->v[0] && t >= prev->v[1]) {
+		human(rx, sizeof(rx), (r - prev->v[0]) * 1000 / (ms - prev->t));
+		human(tx, sizeof(tx), (t - prev->v[1]) * 1000 / (ms - prev->t));
+		snprintf(buf, size, "%s %s", rx, tx);
+	}
+	prev->v[0] = r;
+	prev->v[1] = t;
+}
+
+/* joins the parts into buf[back]; returns whether the text changed */
+static int
+join(void)
+{
+	static char last[STATUS_SIZ];
+	char *s = buf[back];
+	size_t i, len = 0;
+
+	*s = '\0';
+	for (i = 0; i < nmods; i++) {
+		if (!*parts[i])
+			continue;
+		len += snprintf(s + len, STATUS_SIZ - len, "%s%s", len ? sep : "", parts[i]);
+		len = MIN(len, STATUS_SIZ - 1);
+	}
+	if (!strcmp(s, last))
+		return 0;
+	strcpy(last, s);
+	return 1;
+}
+
+static void *
+worker(void *arg)
+{
+	struct timespec ts;
+	long long t, next;
+	uint64_t one = 1;
+	size_t i;
+	int changed;
+
+	pthread_mutex_lock(&lock);
+	while (!stop) {
+		pthread_mutex_unlock(&lock);
+		t = now();
+		next = t + 60000;
+		changed = 0;
+		for (i = 0; i < nmods; i++) {
+			if (due[i] <= t) {
+				*parts[i] = '\0';
+				mods[i].func(parts[i], PART_SIZ, mods[i].arg, &prevs[i]);
+				prevs[i].t = t;
+				due[i] = t + MAX(mods[i].interval, 1);
+				changed = 1;
+			}
+			next = MIN(next, due[i]);
+		}
+		if (changed && join()) {
+			back = __atomic_exchange_n(&ready, back | FRESH, __ATOMIC_ACQ_REL) & ~FRESH;
+			if (write(statusfd, &one, sizeof(one)) < 0)
+				; /* counter already pending */
+		}
+
+		pthread_mutex_lock(&lock);
+		ts.tv_sec = next / 1000;
+		ts.tv_nsec = next % 1000 * 1000000;
+		while (!stop && pthread_cond_timedwait(&cond, &lock, &ts) != ETIMEDOUT)
+			;
+	}
+	pthread_mutex_unlock(&lock);
+	return NULL;
+}
+
+/* Starts updating the status text from the n modules. Returns a descriptor
+ * that becomes readable when status_read() has new text, or -1. */
+int
+status_start(const StatusModule *m, size_t n, const char *s)
+{
+	pthread_condattr_t attr;
+
+	if (statusfd >= 0 || !n)
+		return statusfd;
+	if ((statusfd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)) < 0)
+		return -1;
+	mods = m;
+	nmods = n;
+	sep = s;
+	parts = ecalloc(n, sizeof(*parts));
+	prevs = ecalloc(n, sizeof(StatusPrev));
+	due = ecalloc(n, sizeof(long long));
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cond, &attr);
+	pthread_condattr_destroy(&attr);
+	stop = 0;
+	if (pthread_create(&thread, NULL, worker, NULL)) {
+		status_stop();
+		return -1;
+	}
+	running = 1;
+	return statusfd;
+}
+
+/* copies the latest text to s; returns 0 if there is none since the last
+ * call */
+int
+status_read(char *s, size_t size)
+{
+	uint64_t n;
+
+	if (statusfd < 0)
+		return 0;
+	if (read(statusfd, &n, sizeof(n)) < 0)
+		; /* nothing signalled, the text may still be fresh */
+	if (!(__atomic_load_n(&ready, __ATOMIC_ACQUIRE) & FRESH))
+		return 0;
+	front = __atomic_exchange_n(&ready, front, __ATOMIC_ACQ_REL) & ~FRESH;
+	snprintf(s, size, "%s", buf[front]);
+	return 1;
+}
+
+void
+status_stop(void)
+{
+	if (statusfd < 0)
+		return;
+	if (running) {
+		pthread_mutex_lock(&lock);
+		stop = 1;
+		pthread_cond_signal(&cond);
+		pthread_mutex_unlock(&lock);
+		pthread_join(thread, NULL);
+		running = 0;
+	}
+	pthread_cond_destroy(&cond);
+	close(statusfd);
+	statusfd = -1;
+	free(parts);
+	free(prevs);
+	free(due);
+	parts = NULL;
+	prevs = NULL;
+	due = NULL;
+}
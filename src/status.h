@@ -0,0 +1,31 @@
+/* See LICENSE file for copyright and license details. */
+#ifndef dwm_status_h
+#define dwm_status_h
+#include <stddef.h>
+
+/* Status text produced inside dwm instead of by a script setting the root
+ * window name. Each module writes its part of the text into buf and runs
+ * every interval ms on a worker thread; the parts that are not empty are
+ * joined with a separator. prev is kept for the module between calls. */
+typedef struct {
+	long long t;             /* of the last call, in ms, 0 on the first */
+	unsigned long long v[2];
+} StatusPrev;
+
+typedef struct {
+	void (*func)(char *buf, size_t size, const char *arg, StatusPrev *prev);
+	const char *arg;
+	unsigned int interval;
+} StatusModule;
+
+/* modules, see their arg in status.c */
+void status_battery(char *buf, size_t size, const char *arg, StatusPrev *prev);
+void status_clock(char *buf, size_t size, const char *arg, StatusPrev *prev);
+void status_load(char *buf, size_t size, const char *arg, StatusPrev *prev);
+void status_mem(char *buf, size_t size, const char *arg, StatusPrev *prev);
+void status_net(char *buf, size_t size, const char *arg, StatusPrev *prev);
+
+int status_start(const StatusModule *mods, size_t n, const char *sep);
+int status_read(char *buf, size_t size);
+void status_stop(void);
+#endif // dwm_status_h
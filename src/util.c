@@ -1,11 +1,21 @@
 /* See LICENSE file for copyright and license details. */
 #include <stdarg.h>
+#ifdef ALLOCSTATS
+#include <malloc.h>
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "util.h"
 
+#ifdef ALLOCSTATS
+/* the plain functions below are wrapped by the accounting ones */
+#undef ecalloc
+#undef erealloc
+#undef free
+#endif
+
 void
 die(const char *fmt, ...)
 {
@@ -34,3 +44,198 @@ ecalloc(size_t nmemb, size_t size)
 		die("calloc:");
 	return p;
 }
+
+void *
+erealloc(void *p, size_t size)
+{
+	if (!(p = realloc(p, size)))
+		die("realloc:");
+	return p;
+}
+
+#ifdef ALLOCSTATS
+#define MAXKINDS 128
+
+typedef struct {
+	char name[32];
+	size_t live, bytes, peak, total;
+} AllocKind;
+
+typedef struct {
+	void *p; /* NULL if free, (void *)-1 if deleted */
+	size_t size;
+	unsigned int kind;
+} AllocEnt;
+
+static AllocKind kinds[MAXKINDS];
+static unsigned int nkinds;
+static AllocEnt *table; /* open addressing, of live allocations */
+static size_t tabsize, tabused;
+static size_t live, bytes, peak;
+
+/* the kind of that name, without the directory of a file name */
+static unsigned int
+kindof(const char *kind)
+{
+	const char *s;
+	char name[sizeof(kinds[0].name)];
+	unsigned int i;
+
+	if ((s = strrchr(kind, '/')))
+		kind = s + 1;
+	snprintf(name, sizeof(name), "%s", kind);
+	for (i = 0; i < nkinds && strcmp(kinds[i].name, name); i++)
+		;
+	if (i == nkinds) {
+		if (nkinds == MAXKINDS - 1)
+			return MAXKINDS - 1; /* shared by the rest */
+		strcpy(kinds[nkinds++].name, name);
+	}
+	return i;
+}
+
+static size_t
+slotof(void *p)
+{
+	return ((size_t)p >> 4) * 2654435761u & (tabsize - 1);
+}
+
+static AllocEnt *
+lookup(void *p)
+{
+	size_t i;
+
+	if (!tabsize)
+		return NULL;
+	for (i = slotof(p); table[i].p; i = (i + 1) & (tabsize - 1))
+		if (table[i].p == p)
+			return &table[i];
+	return NULL;
+}
+
+static void
+insert(void *p, size_t size, unsigned int kind)
+{
+	size_t i;
+
+	for (i = slotof(p); table[i].p && table[i].p != (void *)-1; i = (i + 1) & (tabsize - 1))
+		;
+	if (!table[i].p)
+		tabused++;
+	table[i] = (AllocEnt){ p, size, kind };
+}
+
+static void
+track(void *p, size_t size, unsigned int kind)
+{
+	AllocEnt *old = table;
+	size_t i, n = tabsize;
+
+	/* rehashed when half full, tombstones included */
+	if (2 * (tabused + 1) > tabsize) {
+		if (2 * live >= tabsize / 2)
+			tabsize = tabsize ? 2 * tabsize : 1024;
+		if (!(table = calloc(tabsize, sizeof(AllocEnt))))
+			die("calloc:");
+		tabused = 0;
+		for (i = 0; i < n; i++)
+			if (old[i].p && old[i].p != (void *)-1)
+				insert(old[i].p, old[i].size, old[i].kind);
+		free(old);
+	}
+	insert(p, size, kind);
+	kinds[kind].live++;
+	kinds[kind].total++;
+	kinds[kind].bytes += size;
+	kinds[kind].peak = MAX(kinds[kind].peak, kinds[kind].bytes);
+	live++;
+	bytes += size;
+	peak = MAX(peak, bytes);
+}
+
+static void
+untrack(AllocEnt *e)
+{
+	kinds[e->kind].live--;
+	kinds[e->kind].bytes -= e->size;
+	live--;
+	bytes -= e->size;
+	e->p = (void *)-1;
+}
+
+void *
+ecalloc_kind(size_t nmemb, size_t size, const char *kind)
+{
+	void *p = ecalloc(nmemb, size);
+
+	track(p, nmemb * size, kindof(kind));
+	return p;
+}
+
+void *
+erealloc_kind(void *p, size_t size, const char *kind)
+{
+	AllocEnt *e = p ? lookup(p) : NULL;
+	unsigned int k = e ? e->kind : kindof(kind);
+
+	if (e)
+		untrack(e);
+	p = erealloc(p, size);
+	track(p, size, k);
+	return p;
+}
+
+void
+alloc_count(void *p, const char *kind)
+{
+	if (p)
+		track(p, 0, kindof(kind));
+}
+
+void
+alloc_forget(void *p)
+{
+	AllocEnt *e;
+
+	if (p && (e = lookup(p)))
+		untrack(e);
+}
+
+void
+efree(void *p)
+{
+	alloc_forget(p);
+	free(p);
+}
+
+void
+alloc_totals(AllocTotals *t)
+{
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+	struct mallinfo2 mi = mallinfo2();
+
+	t->heap = mi.uordblks + mi.hblkhd;
+#else
+	t->heap = 0;
+#endif
+	t->live = live;
+	t->bytes = bytes;
+	t->peak = peak;
+}
+
+/* writes the accounting per kind to stderr */
+void
+alloc_dump(void)
+{
+	AllocTotals t;
+	unsigned int i;
+
+	alloc_totals(&t);
+	fprintf(stderr, "dwm: %zu allocations live, %zu bytes, peak %zu bytes, heap %zu bytes\n",
+	        t.live, t.bytes, t.peak, t.heap);
+	fprintf(stderr, "%-32s %8s %10s %10s %10s\n", "kind", "live", "bytes", "peak", "total");
+	for (i = 0; i < nkinds; i++)
+		fprintf(stderr, "%-32s %8zu %10zu %10zu %10zu\n", kinds[i].name,
+		        kinds[i].live, kinds[i].bytes, kinds[i].peak, kinds[i].total);
+}
+#endif /* ALLOCSTATS */
@@ -8,4 +8,33 @@
 
 void die(const char *fmt, ...);
 void *ecalloc(size_t nmemb, size_t size);
+void *erealloc(void *p, size_t size);
+
+#ifdef ALLOCSTATS
+/* Accounting of the allocations made through ecalloc() and erealloc(), by
+ * kind: the file and line of the call. free() of such memory has to see
+ * this header. Memory a library hands out is counted by alloc_count(),
+ * of unknown size, until alloc_forget() before the library frees it. */
+typedef struct {
+	size_t live, bytes;   /* allocations not freed yet */
+	size_t peak;          /* high-water mark of bytes */
+	size_t heap;          /* all of malloc(), libraries included, or 0 */
+} AllocTotals;
+
+void *ecalloc_kind(size_t nmemb, size_t size, const char *kind);
+void *erealloc_kind(void *p, size_t size, const char *kind);
+void efree(void *p);
+void alloc_count(void *p, const char *kind);
+void alloc_forget(void *p);
+void alloc_totals(AllocTotals *t);
+void alloc_dump(void);
+#define ALLOCSTR(x)    #x
+#define ALLOCKIND(l)   __FILE__ ":" ALLOCSTR(l)
+#define ecalloc(n, s)  ecalloc_kind(n, s, ALLOCKIND(__LINE__))
+#define erealloc(p, s) erealloc_kind(p, s, ALLOCKIND(__LINE__))
+#define free(p)        efree(p)
+#else
+#define alloc_count(p, kind)
+#define alloc_forget(p)
+#endif /* ALLOCSTATS */
 #endif // dwm_util_h
@@ -0,0 +1,91 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks grid_query() of grid.c against a scan of all rectangles, on random
+ * grids with rectangles and queries partly or wholly outside of them, the
+ * way hidden windows and other monitors are. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/grid.h"
+#include "../src/util.h"
+
+#define MAXITEMS 200
+
+typedef struct {
+	int x, y, w, h;
+} Rect;
+
+static int
+rnd(int n)
+{
+	return n > 0 ? rand() % n : 0;
+}
+
+static void
+randrect(Rect *r, int gw, int gh)
+{
+	r->x = rnd(3 * gw) - gw;
+	r->y = rnd(3 * gh) - gh;
+	r->w = rnd(4) ? rnd(gw / 2 + 1) : rnd(2);
+	r->h = rnd(4) ? rnd(gh / 2 + 1) : rnd(2);
+}
+
+static int
+overlaps(const Rect *a, const Rect *b)
+{
+	return a->x < b->x + b->w && b->x < a->x + a->w &&
+	       a->y < b->y + b->h && b->y < a->y + a->h;
+}
+
+static int
+check(void)
+{
+	static Rect items[MAXITEMS];
+	static int got[MAXITEMS];
+	const GridItem **hits;
+	Grid *g;
+	Rect q;
+	unsigned int bad = 0, queries = 0;
+	int it, k, i, n, gw, gh, diff;
+	size_t j, nhits;
+
+	srand(1);
+	for (it = 0; it < 500; it++) {
+		gw = 1 + rnd(4000);
+		gh = 1 + rnd(3000);
+		g = grid_create(gw, gh, 16 << rnd(4));
+		/* cleared and filled again, as dwm does when windows move */
+		for (k = 0; k < 4; k++) {
+			grid_clear(g);
+			n = rnd(MAXITEMS + 1);
+			for (i = 0; i < n; i++) {
+				randrect(&items[i], gw, gh);
+				grid_insert(g, items[i].x, items[i].y, items[i].w,
+				            items[i].h, &items[i]);
+			}
+			for (j = 0; j < 50; j++, queries++) {
+				randrect(&q, gw, gh);
+				memset(got, 0, sizeof got);
+				nhits = grid_query(g, q.x, q.y, q.w, q.h, &hits);
+				diff = 0;
+				for (i = 0; i < (int)nhits; i++)
+					diff |= got[(Rect *)hits[i]->data - items]++;
+				for (i = 0; i < n; i++)
+					diff |= overlaps(&items[i], &q) != got[i];
+				bad += diff;
+			}
+		}
+		grid_free(g);
+	}
+	printf("grid: %u of %u queries differ from a linear scan\n", bad, queries);
+	return bad != 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+	if (argc != 1)
+		die("usage: grid");
+	return check();
+}
@@ -0,0 +1,280 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Checks layout.c against the arithmetic tile(), monocle() and
+ * applysizehints() did in dwm.c before it was split out, kept here as it
+ * was, on random monitors, hints and settings. With -b, times the layouts
+ * for 10 to 10000 clients instead. Built with -DALLOCSTATS, also fails
+ * when allocations are still live at the end. */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/layout.h"
+#include "../src/util.h"
+
+#define NCLIENTS 10000
+#define MAXCHECK 64
+#define HEIGHT(X) ((X)->h + 2 * (X)->bw)
+
+typedef struct {
+	int x, y, w, h, bw;
+	int basew, baseh, incw, inch, maxw, maxh, minw, minh;
+	float mina, maxa;
+	int hints;
+} Client;
+
+typedef struct {
+	int wx, wy, ww, wh;
+	float mfact;
+	int nmaster;
+} Monitor;
+
+static int bh;
+
+/* applysizehints() of the baseline, for tiled clients */
+static int
+applysizehints(Client *c, Monitor *m, int *x, int *y, int *w, int *h)
+{
+	int baseismin;
+
+	*w = MAX(1, *w);
+	*h = MAX(1, *h);
+	if (*x >= m->wx + m->ww)
+		*x = m->wx + m->ww - (c->w + 2 * c->bw);
+	if (*y >= m->wy + m->wh)
+		*y = m->wy + m->wh - HEIGHT(c);
+	if (*x + *w + 2 * c->bw <= m->wx)
+		*x = m->wx;
+	if (*y + *h + 2 * c->bw <= m->wy)
+		*y = m->wy;
+	if (*h < bh)
+		*h = bh;
+	if (*w < bh)
+		*w = bh;
+	if (c->hints) {
+		baseismin = c->basew == c->minw && c->baseh == c->minh;
+		if (!baseismin) {
+			*w -= c->basew;
+			*h -= c->baseh;
+		}
+		if (c->mina > 0 && c->maxa > 0) {
+			if (c->maxa < (float)*w / *h)
+				*w = *h * c->maxa + 0.5;
+			else if (c->mina < (float)*h / *w)
+				*h = *w * c->mina + 0.5;
+		}
+		if (baseismin) {
+			*w -= c->basew;
+			*h -= c->baseh;
+		}
+		if (c->incw)
+			*w -= *w % c->incw;
+		if (c->inch)
+			*h -= *h % c->inch;
+		*w = MAX(*w + c->basew, c->minw);
+		*h = MAX(*h + c->baseh, c->minh);
+		if (c->maxw)
+			*w = MIN(*w, c->maxw);
+		if (c->maxh)
+			*h = MIN(*h, c->maxh);
+	}
+	return *x != c->x || *y != c->y || *w != c->w || *h != c->h;
+}
+
+static void
+resize(Client *c, Monitor *m, int x, int y, int w, int h)
+{
+	if (applysizehints(c, m, &x, &y, &w, &h)) {
+		c->x = x;
+		c->y = y;
+		c->w = w;
+		c->h = h;
+	}
+}
+
+/* tile() of the baseline */
+static void
+tile(Monitor *m, Client *cs, unsigned int n)
+{
+	unsigned int i, h, mw, my, ty;
+	Client *c;
+
+	if (n == 0)
+		return;
+	if (n > m->nmaster)
+		mw = m->nmaster ? m->ww * m->mfact : 0;
+	else
+		mw = m->ww;
+	for (i = my = ty = 0; i < n; i++) {
+		c = &cs[i];
+		if (i < m->nmaster) {
+			h = (m->wh - my) / (MIN(n, m->nmaster) - i);
+			resize(c, m, m->wx, m->wy + my, mw - (2 * c->bw), h - (2 * c->bw));
+			if (my + HEIGHT(c) < m->wh)
+				my += HEIGHT(c);
+		} else {
+			h = (m->wh - ty) / (n - i);
+			resize(c, m, m->wx + mw, m->wy + ty, m->ww - mw - (2 * c->bw),
+			       h - (2 * c->bw));
+			if (ty + HEIGHT(c) < m->wh)
+				ty += HEIGHT(c);
+		}
+	}
+}
+
+/* monocle() of the baseline */
+static void
+monocle(Monitor *m, Client *cs, unsigned int n)
+{
+	unsigned int i;
+
+	for (i = 0; i < n; i++)
+		resize(&cs[i], m, m->wx, m->wy, m->ww - 2 * cs[i].bw, m->wh - 2 * cs[i].bw);
+}
+
+static void
+describe(const Client *c, LayoutClient *lc)
+{
+	*lc = (LayoutClient){ c->x, c->y, c->w, c->h, c->bw,
+		c->basew, c->baseh, c->incw, c->inch, c->maxw, c->maxh,
+		c->minw, c->minh, c->mina, c->maxa, c->hints };
+}
+
+static int
+rnd(int n)
+{
+	return n ? rand() % n : 0;
+}
+
+static void
+randclient(Client *c)
+{
+	memset(c, 0, sizeof(*c));
+	c->x = rnd(500);
+	c->y = rnd(500);
+	c->w = 1 + rnd(500);
+	c->h = 1 + rnd(500);
+	c->bw = rnd(4);
+	c->hints = rnd(2);
+	c->basew = rnd(30);
+	c->baseh = rnd(30);
+	c->minw = rnd(3) ? c->basew : rnd(50);
+	c->minh = rnd(3) ? c->baseh : rnd(50);
+	c->incw = rnd(3) ? 0 : rnd(20);
+	c->inch = rnd(3) ? 0 : rnd(20);
+	c->maxw = rnd(4) ? 0 : rnd(800);
+	c->maxh = rnd(4) ? 0 : rnd(800);
+	if (!rnd(4)) {
+		c->mina = 0.5;
+		c->maxa = 2.0;
+	}
+}
+
+static int
+same(const Client *c, const LayoutRect *r)
+{
+	return c->x == r->x && c->y == r->y && c->w == r->w && c->h == r->h;
+}
+
+static int
+check(void)
+{
+	Client *old;
+	LayoutClient *lc;
+	LayoutRect *r = NULL;
+	Monitor m;
+	LayoutRect area;
+	unsigned int i, n, diff, bad = 0, runs = 20000;
+	int it;
+
+	srand(1);
+	for (it = 0; it < runs; it++) {
+		n = rnd(MAXCHECK);
+		old = ecalloc(n + 1, sizeof(Client));
+		lc = ecalloc(n + 1, sizeof(LayoutClient));
+		r = erealloc(r, (n + 1) * sizeof(LayoutRect));
+		bh = 10 + rnd(20);
+		m = (Monitor){ rnd(2000), rnd(100), 200 + rnd(3000), 100 + rnd(2000),
+		               0.05 + rnd(91) / 100.0, rnd(5) };
+		area = (LayoutRect){ m.wx, m.wy, m.ww, m.wh };
+		for (i = 0; i < n; i++) {
+			randclient(&old[i]);
+			describe(&old[i], &lc[i]);
+		}
+		if (it % 2) {
+			tile(&m, old, n);
+			layout_tile(&area, m.mfact, m.nmaster, bh, lc, n, r);
+		} else {
+			monocle(&m, old, n);
+			layout_monocle(&area, bh, lc, n, r);
+		}
+		for (i = diff = 0; i < n; i++)
+			diff |= !same(&old[i], &r[i]);
+		bad += diff;
+		free(old);
+		free(lc);
+	}
+	free(r);
+	printf("layout: %u of %u arrangements differ from the baseline\n", bad, runs);
+	return bad != 0;
+}
+
+static double
+elapsed(struct timespec *t0)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - t0->tv_sec) * 1e9 + (t.tv_nsec - t0->tv_nsec);
+}
+
+static void
+bench(void)
+{
+	static LayoutClient lc[NCLIENTS];
+	static LayoutRect r[NCLIENTS];
+	LayoutRect area = { 0, 20, 2560, 1420 };
+	struct timespec t0;
+	unsigned int i, k, n, reps;
+	double tns, mns;
+
+	for (i = 0; i < NCLIENTS; i++)
+		lc[i] = (LayoutClient){ 0, 0, 100, 100, 1, .usehints = 1 };
+	printf("%8s %17s %17s\n", "clients", "tile ns/client", "monocle ns/client");
+	for (n = 10; n <= NCLIENTS; n *= 10) {
+		reps = 2000000 / n;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (k = 0; k < reps; k++)
+			layout_tile(&area, 0.55, 1, 20, lc, n, r);
+		tns = elapsed(&t0) / reps / n;
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		for (k = 0; k < reps; k++)
+			layout_monocle(&area, 20, lc, n, r);
+		mns = elapsed(&t0) / reps / n;
+		printf("%8u %17.1f %17.1f\n", n, tns, mns);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	int bad;
+#ifdef ALLOCSTATS
+	AllocTotals t;
+#endif
+
+	if (argc == 2 && !strcmp(argv[1], "-b")) {
+		bench();
+		return 0;
+	}
+	if (argc != 1)
+		die("usage: layout [-b]");
+	bad = check();
+#ifdef ALLOCSTATS
+	alloc_totals(&t);
+	printf("layout: %zu allocations live at the end\n", t.live);
+	bad |= t.live != 0;
+#endif
+	return bad;
+}
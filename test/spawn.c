@@ -0,0 +1,124 @@
+/* See LICENSE file for copyright and license details.
+ *
+ * Times the way from a key binding to the exec of its command, the way
+ * spawn() used to start it, with fork(), and the way it does now, with
+ * posix_spawnp(), for a parent with 0 to 256 MiB of memory touched. The
+ * time ends when the command has replaced the child, which closes the
+ * write end of a close-on-exec pipe. */
+#define _GNU_SOURCE /* for POSIX_SPAWN_SETSID of glibc */
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/util.h"
+
+#ifdef POSIX_SPAWN_SETSID
+#define SPAWNFLAGS (POSIX_SPAWN_SETSID | POSIX_SPAWN_SETSIGMASK)
+#else
+#define SPAWNFLAGS POSIX_SPAWN_SETSIGMASK
+#endif
+
+#define REPS 200
+
+extern char **environ;
+
+static char *const cmd[] = { "true", NULL };
+
+static double
+elapsed(struct timespec *t0)
+{
+	struct timespec t;
+
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (t.tv_sec - t0->tv_sec) * 1e6 + (t.tv_nsec - t0->tv_nsec) / 1e3;
+}
+
+/* what launch() in dwm.c did before */
+static pid_t
+byfork(void)
+{
+	sigset_t set;
+	pid_t pid;
+
+	if ((pid = fork()) == 0) {
+		setsid();
+		sigemptyset(&set);
+		sigprocmask(SIG_SETMASK, &set, NULL);
+		execvp(cmd[0], cmd);
+		_exit(1);
+	}
+	if (pid < 0)
+		die("fork:");
+	return pid;
+}
+
+/* what launch() in dwm.c does */
+static pid_t
+byspawn(void)
+{
+	posix_spawnattr_t attr;
+	sigset_t set;
+	pid_t pid;
+	int err;
+
+	sigemptyset(&set);
+	posix_spawnattr_init(&attr);
+	posix_spawnattr_setflags(&attr, SPAWNFLAGS);
+	posix_spawnattr_setsigmask(&attr, &set);
+	err = posix_spawnp(&pid, cmd[0], NULL, &attr, cmd, environ);
+	posix_spawnattr_destroy(&attr);
+	if (err)
+		die("posix_spawnp: %s", strerror(err));
+	return pid;
+}
+
+/* mean microseconds from the call to the exec of cmd */
+static double
+latency(pid_t (*start)(void))
+{
+	struct timespec t0;
+	double us = 0;
+	char c;
+	int fd[2], i;
+	pid_t pid;
+
+	for (i = 0; i < REPS; i++) {
+		if (pipe(fd) < 0)
+			die("pipe:");
+		fcntl(fd[1], F_SETFD, FD_CLOEXEC);
+		clock_gettime(CLOCK_MONOTONIC, &t0);
+		pid = start();
+		close(fd[1]);
+		while (read(fd[0], &c, 1) > 0)
+			;
+		us += elapsed(&t0);
+		close(fd[0]);
+		waitpid(pid, NULL, 0);
+	}
+	return us / REPS;
+}
+
+int
+main(int argc, char *argv[])
+{
+	char *heap = NULL;
+	size_t mib;
+
+	if (argc != 1)
+		die("usage: spawn");
+	printf("%8s %12s %18s\n", "heap MiB", "fork us", "posix_spawn us");
+	for (mib = 0; mib <= 256; mib = mib ? mib * 4 : 16) {
+		/* touched, so that fork() has the page tables to copy */
+		heap = erealloc(heap, mib * 1024 * 1024 + 1);
+		memset(heap, 1, mib * 1024 * 1024 + 1);
+		printf("%8zu %12.1f %18.1f\n", mib, latency(byfork), latency(byspawn));
+	}
+	free(heap);
+	return 0;
+}